@@ -141,6 +141,7 @@ struct krnl_t
 	struct memphy_struct **mswp;
 	struct memphy_struct *active_mswp;
 	uint32_t active_mswp_id;
+	addr_t zero_fpn; /* shared read-only zero frame in mram */
 #endif
 };
 
@@ -15,9 +15,12 @@
 #define SYSMEM_SWP_OP 3
 #define SYSMEM_IO_READ 4
 #define SYSMEM_IO_WRITE 5
+#define SYSMEM_MMAP_OP 6
+#define SYSMEM_STACK_OP 7
 
 extern struct vm_area_struct *get_vma_by_num(struct mm_struct *mm, int vmaid);
 int liballoc(struct pcb_t *, addr_t, uint32_t);
 int libfree(struct pcb_t *, uint32_t);
 int libread(struct pcb_t*, uint32_t, addr_t, uint32_t*);
 int libwrite(struct pcb_t*, BYTE, uint32_t, addr_t);
+int free_pcb_memph(struct pcb_t *);
@@ -5,5 +5,9 @@
 
 struct pcb_t * load(const char * path);
 
+uint32_t alloc_pid(void);
+
+struct pcb_t * clone_proc(struct pcb_t * parent);
+
 #endif
 
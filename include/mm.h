@@ -14,17 +14,61 @@
 #define PAGING_MAX_PGN  (DIV_ROUND_UP(BIT(PAGING_CPU_BUS_WIDTH),PAGING_PAGESZ))
 
 #define PAGING_SBRK_INIT_SZ PAGING_PAGESZ
+#define PAGING_FPN_INVALID ((addr_t)-1)
+#define PAGING_PGN_INVALID ((addr_t)-1)
+#ifdef MM64
+/* PTE BIT
+ * 64-bit entry, bit 63 is left to PAGING64_PMD_HUGE_MASK (mm64.h)
+ */
+#define PAGING_PTE_PRESENT_MASK BIT_ULL(62)
+#define PAGING_PTE_SWAPPED_MASK BIT_ULL(61)
+#define PAGING_PTE_RESERVE_MASK BIT_ULL(60)
+#define PAGING_PTE_DIRTY_MASK BIT_ULL(59)
+#define PAGING_PTE_WRPROT_MASK BIT_ULL(58)
+#define PAGING_PTE_ACCESSED_MASK BIT_ULL(57)
+#define PAGING_PTE_SHM_MASK PAGING_PTE_RESERVE_MASK /* frame of a segment or cached file */
+
+/* PTE BIT PRESENT */
+#define PAGING_PTE_SET_PRESENT(pte) (pte=pte|PAGING_PTE_PRESENT_MASK)
+#define PAGING_PAGE_PRESENT(pte) (pte&PAGING_PTE_PRESENT_MASK)
+#define PAGING_PAGE_WRPROT(pte) (pte&PAGING_PTE_WRPROT_MASK)
+#define PAGING_PAGE_ACCESSED(pte) (pte&PAGING_PTE_ACCESSED_MASK)
+#define PAGING_PAGE_SHM(pte) (pte&PAGING_PTE_SHM_MASK)
+
+/* USRNUM */
+#define PAGING_PTE_USRNUM_LOBIT 48
+#define PAGING_PTE_USRNUM_HIBIT 56
+/* FPN - 48 bits, up to 2^48 frames */
+#define PAGING_PTE_FPN_LOBIT 0
+#define PAGING_PTE_FPN_HIBIT 47
+/* SWPTYP */
+#define PAGING_PTE_SWPTYP_LOBIT 0
+#define PAGING_PTE_SWPTYP_HIBIT 4
+/* SWPOFF - 43 bits */
+#define PAGING_PTE_SWPOFF_LOBIT 5
+#define PAGING_PTE_SWPOFF_HIBIT 47
+
+/* PTE */
+#define PAGING_PTE_USRNUM_MASK GENMASK_ULL(PAGING_PTE_USRNUM_HIBIT,PAGING_PTE_USRNUM_LOBIT)
+#define PAGING_PTE_FPN_MASK    GENMASK_ULL(PAGING_PTE_FPN_HIBIT,PAGING_PTE_FPN_LOBIT)
+#define PAGING_PTE_SWPTYP_MASK GENMASK_ULL(PAGING_PTE_SWPTYP_HIBIT,PAGING_PTE_SWPTYP_LOBIT)
+#define PAGING_PTE_SWPOFF_MASK GENMASK_ULL(PAGING_PTE_SWPOFF_HIBIT,PAGING_PTE_SWPOFF_LOBIT)
+#else
 /* PTE BIT */
 #define PAGING_PTE_PRESENT_MASK BIT(31) 
 #define PAGING_PTE_SWAPPED_MASK BIT(30)
 #define PAGING_PTE_RESERVE_MASK BIT(29)
 #define PAGING_PTE_DIRTY_MASK BIT(28)
-#define PAGING_PTE_EMPTY01_MASK BIT(14)
-#define PAGING_PTE_EMPTY02_MASK BIT(13)
+#define PAGING_PTE_WRPROT_MASK BIT(14)
+#define PAGING_PTE_ACCESSED_MASK BIT(13)
+#define PAGING_PTE_SHM_MASK PAGING_PTE_RESERVE_MASK /* frame of a segment or cached file */
 
 /* PTE BIT PRESENT */
 #define PAGING_PTE_SET_PRESENT(pte) (pte=pte|PAGING_PTE_PRESENT_MASK)
 #define PAGING_PAGE_PRESENT(pte) (pte&PAGING_PTE_PRESENT_MASK)
+#define PAGING_PAGE_WRPROT(pte) (pte&PAGING_PTE_WRPROT_MASK)
+#define PAGING_PAGE_ACCESSED(pte) (pte&PAGING_PTE_ACCESSED_MASK)
+#define PAGING_PAGE_SHM(pte) (pte&PAGING_PTE_SHM_MASK)
 
 /* USRNUM */
 #define PAGING_PTE_USRNUM_LOBIT 15
@@ -45,6 +89,8 @@
 #define PAGING_PTE_SWPTYP_MASK GENMASK(PAGING_PTE_SWPTYP_HIBIT,PAGING_PTE_SWPTYP_LOBIT)
 #define PAGING_PTE_SWPOFF_MASK GENMASK(PAGING_PTE_SWPOFF_HIBIT,PAGING_PTE_SWPOFF_LOBIT)
 
+#endif
+
 /* Extract PTE */
 #define PAGING_PTE_OFFST(pte) GETVAL(pte,PAGING_OFFST_MASK,PAGING_ADDR_OFFST_LOBIT)
 #define PAGING_PTE_PGN(pte)   GETVAL(pte,PAGING_PGN_MASK,PAGING_ADDR_PGN_LOBIT)
@@ -67,6 +113,7 @@
 #define PAGING_SWP_LOBIT NBITS(PAGING_PAGESZ)
 #define PAGING_SWP_HIBIT (NBITS(PAGING_MEMSWPSZ) - 1)
 #define PAGING_SWP(pte) ((pte&PAGING_PTE_SWPOFF_MASK) >> PAGING_SWPFPN_OFFSET)
+#define PAGING_SWPTYP(pte) ((pte&PAGING_PTE_SWPTYP_MASK) >> PAGING_PTE_SWPTYP_LOBIT)
 
 /* Value operators */
 #define SETBIT(v,mask) (v=v|mask)
@@ -104,18 +151,22 @@ int enlist_vm_rg_node(struct vm_rg_struct **rglist, struct vm_rg_struct* rgnode)
 int enlist_pgn_node(struct pgn_t **pgnlist, addr_t pgn);
 int vmap_pgd_memset(struct pcb_t *caller, addr_t addr, int pgnum);
 addr_t vmap_page_range(struct pcb_t *caller, addr_t addr, int pgnum, 
-                    struct framephy_struct *frames, struct vm_rg_struct *ret_rg);
+                    addr_t *frames, struct vm_rg_struct *ret_rg);
 addr_t vm_map_ram(struct pcb_t *caller, addr_t astart, addr_t aend, addr_t mapstart, int incpgnum, struct vm_rg_struct *ret_rg);
-addr_t alloc_pages_range(struct pcb_t *caller, int incpgnum, struct framephy_struct **frm_lst);
+int vmap_huge_page(struct pcb_t *caller, addr_t addr);
+addr_t alloc_pages_range(struct pcb_t *caller, int incpgnum, addr_t *frames);
 int __swap_cp_page(struct memphy_struct *mpsrc, addr_t srcfpn,
                 struct memphy_struct *mpdst, addr_t dstfpn) ;
 int get_pd_from_address(addr_t addr, addr_t* pgd, addr_t* p4d, addr_t* pud, addr_t* pmd, addr_t* pt);
 int get_pd_from_pagenum(addr_t pgn, addr_t* pgd, addr_t* p4d, addr_t* pud, addr_t* pmd, addr_t* pt);
 int pte_set_fpn(struct pcb_t *caller, addr_t pgn, addr_t fpn);
 int pte_set_swap(struct pcb_t *caller, addr_t pgn, int swptyp, addr_t swpoff);
-uint32_t pte_get_entry(struct pcb_t *caller, addr_t pgn);
-int pte_set_entry(struct pcb_t *caller, addr_t pgn, uint32_t pte_val);
-int init_pte(addr_t *pte,
+pte_t pte_get_entry(struct pcb_t *caller, addr_t pgn);
+int pte_set_entry(struct pcb_t *caller, addr_t pgn, pte_t pte_val);
+int pte_mkyoung(struct mm_struct *mm, addr_t pgn);
+int pte_test_and_clear_young(struct mm_struct *mm, addr_t pgn);
+int pte_mkdirty(struct mm_struct *mm, addr_t pgn);
+int init_pte(pte_t *pte,
              int pre,    // present
              addr_t fpn,    // FPN
              int drt,    // dirty
@@ -127,6 +178,8 @@ int __free(struct pcb_t *caller, int vmaid, int rgid);
 int __read(struct pcb_t *caller, int vmaid, int rgid, addr_t offset, BYTE *data);
 int __write(struct pcb_t *caller, int vmaid, int rgid, addr_t offset, BYTE value);
 int init_mm(struct mm_struct *mm, struct pcb_t *caller);
+int dup_mm(struct pcb_t *caller, struct pcb_t *child);
+int free_mm(struct pcb_t *caller);
 
 /* VM prototypes */
 int pgalloc(struct pcb_t *proc, uint32_t size, uint32_t reg_index);
@@ -143,19 +196,124 @@ int pgwrite(
 		addr_t offset);
 /* Local VM prototypes */
 struct vm_rg_struct * get_symrg_byid(struct mm_struct* mm, int rgid);
+int symrg_init(struct mm_struct *mm);
+int symrg_dup(struct mm_struct *mm, struct mm_struct *src);
+void symrg_release(struct mm_struct *mm);
+int symrg_get_free(struct mm_struct *mm);
+int symrg_bind(struct mm_struct *mm, int rgid, addr_t start, addr_t end);
 int validate_overlap_vm_area(struct pcb_t *caller, int vmaid, addr_t vmastart, addr_t vmaend);
 int get_free_vmrg_area(struct pcb_t *caller, int vmaid, int size, struct vm_rg_struct *newrg);
 int inc_vma_limit(struct pcb_t *caller, int vmaid, addr_t inc_sz);
 int find_victim_page(struct mm_struct* mm, addr_t *pgn);
 struct vm_area_struct *get_vma_by_num(struct mm_struct *mm, int vmaid);
+struct vm_area_struct *get_vma_by_addr(struct mm_struct *mm, addr_t addr);
+struct vm_area_struct *vm_area_create(struct mm_struct *mm, addr_t start,
+                                      addr_t end, unsigned long flags);
+void vm_area_unlink(struct mm_struct *mm, struct vm_area_struct *vma);
+int vm_area_init(struct mm_struct *mm);
+int vm_area_dup(struct mm_struct *mm, struct mm_struct *src);
+void vm_area_release(struct mm_struct *mm);
+int vm_mmap_anon(struct pcb_t *caller, addr_t len, int rgid, addr_t *addr);
+int vm_stack_push(struct pcb_t *caller, addr_t len, int rgid, addr_t *addr);
+void vm_freerg_init(struct vm_area_struct *vma);
+int vm_freerg_put(struct vm_area_struct *vma, addr_t start, addr_t end);
+int vm_freerg_get(struct vm_area_struct *vma, addr_t size, struct vm_rg_struct *newrg);
+void vm_freerg_dup(struct vm_area_struct *vma, struct vm_area_struct *src);
+void vm_freerg_release(struct vm_area_struct *vma);
 
 /* MEM/PHY protypes */
 int MEMPHY_get_freefp(struct memphy_struct *mp, addr_t *fpn);
+int MEMPHY_get_freefp_n(struct memphy_struct *mp, int num, addr_t *retfpn);
 int MEMPHY_put_freefp(struct memphy_struct *mp, addr_t fpn);
+int MEMPHY_unref_fp(struct memphy_struct *mp, addr_t fpn);
+int MEMPHY_free_fp(struct memphy_struct *mp, addr_t fpn);
+int MEMPHY_get_freefp_range(struct memphy_struct *mp, int num, addr_t *retfpn);
+int MEMPHY_ref_fp(struct memphy_struct *mp, addr_t fpn);
+int MEMPHY_refcnt_fp(struct memphy_struct *mp, addr_t fpn);
 int MEMPHY_read(struct memphy_struct * mp, addr_t addr, BYTE *value);
 int MEMPHY_write(struct memphy_struct * mp, addr_t addr, BYTE data);
+int MEMPHY_read_page(struct memphy_struct *mp, addr_t fpn, BYTE *buf);
+int MEMPHY_write_page(struct memphy_struct *mp, addr_t fpn, const BYTE *buf);
+int MEMPHY_copy_page(struct memphy_struct *mpsrc, addr_t srcfpn,
+                     struct memphy_struct *mpdst, addr_t dstfpn);
+int MEMPHY_submit(struct memphy_struct *mp, addr_t fpn,
+                  struct memphy_struct *peer, addr_t peerfpn, int wr);
+void MEMPHY_unplug(struct memphy_struct *mp);
+int MEMPHY_set_iosched(struct memphy_struct *mp, const char *name,
+                       unsigned long seek, unsigned long xfer);
+void MEMPHY_ioreport(struct memphy_struct *mp, const char *label);
 int MEMPHY_dump(struct memphy_struct * mp);
-int init_memphy(struct memphy_struct *mp, addr_t max_size, int randomflg);
+int init_memphy(struct memphy_struct *mp, uint64_t max_size, int randomflg);
+int init_memphy_file(struct memphy_struct *mp, uint64_t max_size, int randomflg,
+                     const char *path);
+
+/* Page reclaim, the daemon keeps free RAM frames between the watermarks
+ * given in percent of the RAM frames */
+#define KSWAPD_LOW_WMARK_PCT 5
+#define KSWAPD_HIGH_WMARK_PCT 10
+int pg_evict(struct pcb_t *caller);
+int kswapd_register(struct pcb_t *proc);
+int kswapd_unregister(struct pcb_t *proc);
+void kswapd_wakeup(struct memphy_struct *mram);
+int kswapd_start(struct memphy_struct *mram);
+int kswapd_stop(void);
+
+/* Swap devices, a slot is a (swap type, offset) pair.  Victims are
+ * written out in clusters of contiguous slots, faults read the rest of
+ * a cluster back ahead */
+#define SWAP_CLUSTER_PAGES 8
+int swap_init(struct memphy_struct *mswp, int nr, const char *mode);
+struct memphy_struct *swap_device(int swptyp);
+int swap_get_slot(int *swptyp, addr_t *swpoff);
+int swap_get_cluster(int num, int *swptyp, addr_t *swpoff);
+int swap_put_slot(int swptyp, addr_t swpoff);
+int swap_ref_slot(int swptyp, addr_t swpoff);
+int swap_writepage(struct memphy_struct *mram, addr_t fpn, int swptyp, addr_t swpoff);
+int swap_readpage(struct memphy_struct *mram, addr_t fpn, int swptyp, addr_t swpoff);
+int swap_submit_write(struct memphy_struct *mram, addr_t fpn, int swptyp, addr_t swpoff);
+int swap_submit_read(struct memphy_struct *mram, addr_t fpn, int swptyp, addr_t swpoff);
+void swap_unplug(void);
+void swap_report(void);
+
+/* Swap cache, a clean page read back in keeps its slot */
+int swap_cache_init(struct memphy_struct *mram);
+int swap_cache_add(addr_t fpn, int swptyp, addr_t swpoff);
+int swap_cache_get(addr_t fpn, int *swptyp, addr_t *swpoff);
+void swap_cache_drop(addr_t fpn);
+int swap_cache_shrink(void);
+int swap_free_frame(struct memphy_struct *mram, addr_t fpn);
+
+/* Compressed swap cache, the pool holds at most this percent of RAM */
+#define ZSWAP_POOL_PCT 20
+int zswap_init(struct memphy_struct *mram);
+int zswap_store(struct memphy_struct *mram, addr_t fpn, int swptyp, addr_t swpoff);
+int zswap_load(struct memphy_struct *mram, addr_t fpn, int swptyp, addr_t swpoff);
+void zswap_invalidate(int swptyp, addr_t swpoff);
+void zswap_report(void);
+
+/* Shared memory segments, named by a key and kept until shutdown */
+int shm_get(int key, addr_t size);
+int shm_attach(struct pcb_t *caller, int key, int rgid, addr_t *addr);
+int shm_getpage(struct memphy_struct *mram, struct shm_segment *seg, addr_t idx,
+                addr_t newfpn, addr_t *fpn);
+int shm_putpage(struct memphy_struct *mram, struct shm_segment *seg, addr_t idx,
+                addr_t fpn, int swptyp, addr_t swpoff);
+
+/* Page cache of mapped host files, a miss reads this many pages ahead */
+#define PGCACHE_RA_PAGES 8
+int filemap_mmap(struct pcb_t *caller, const char *path, int rgid, addr_t *addr);
+int filemap_getpage(struct memphy_struct *mram, struct pgcache_file *f, addr_t idx,
+                    addr_t newfpn, addr_t *fpn);
+int pgcache_shrink(struct memphy_struct *mram);
+void pgcache_report(void);
+
+/* Page replacement policies: fifo, clock, lru, lfu, arc */
+int pgrepl_init(const char *name, struct memphy_struct *mram);
+int pgrepl_mm_init(struct mm_struct *mm);
+int pgrepl_mm_dup(struct mm_struct *mm, struct mm_struct *src);
+int pgrepl_mm_release(struct mm_struct *mm);
+int pgrepl_add(struct mm_struct *mm, addr_t pgn);
+void pgrepl_report(void);
 
 /* print list */
 int print_list_fp(struct framephy_struct *fp);
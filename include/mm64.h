@@ -48,7 +48,8 @@
 #define PAGING64_ADDR_PGD_LOBIT 48
 
 /* Extract PGD Entry */
-#define PAGING64_ADDR_OFFST(addr) GETVAL(addr,PAGING_ADDR_OFFST_MASK,PAGING_ADDR_OFFST_LOBIT)
+#define PAGING64_ADDR_OFFST(addr) ((addr&PAGING64_ADDR_OFFST_MASK)>>PAGING64_ADDR_OFFST_LOBIT)
+#define PAGING64_ADDR_PGN(addr)   ((addr)>>PAGING64_ADDR_PT_SHIFT)
 #define PAGING64_ADDR_PT(addr)   ((addr&PAGING64_ADDR_PT_MASK)>>PAGING64_ADDR_PT_LOBIT)
 //GETVAL(addr,PAGING64_ADDR_PT_MASK,PAGING64_ADDR_PT_LOBIT)
 #define PAGING64_ADDR_PMD(addr)   ((addr&PAGING64_ADDR_PMD_MASK)>>PAGING64_ADDR_PMD_LOBIT)
@@ -62,13 +63,24 @@
 
 
 /* Masks */
-#define PAGING64_ADDR_OFFST_MASK  GENMASK64(PAGING_ADDR_OFFST_HIBIT,PAGING_ADDR_OFFST_LOBIT)
+#define PAGING64_ADDR_OFFST_MASK  GENMASK64(PAGING64_ADDR_OFFST_HIBIT,PAGING64_ADDR_OFFST_LOBIT)
 #define PAGING64_ADDR_PT_MASK  GENMASK64(PAGING64_ADDR_PT_HIBIT,PAGING64_ADDR_PT_LOBIT)
 #define PAGING64_ADDR_PMD_MASK  GENMASK64(PAGING64_ADDR_PMD_HIBIT,PAGING64_ADDR_PMD_LOBIT)
 #define PAGING64_ADDR_PUD_MASK  GENMASK64(PAGING64_ADDR_PUD_HIBIT,PAGING64_ADDR_PUD_LOBIT)
 #define PAGING64_ADDR_P4D_MASK  GENMASK64(PAGING64_ADDR_P4D_HIBIT,PAGING64_ADDR_P4D_LOBIT)
 #define PAGING64_ADDR_PGD_MASK  GENMASK64(PAGING64_ADDR_PGD_HIBIT,PAGING64_ADDR_PGD_LOBIT)
 
+/* HUGE PAGE
+ * A PMD entry either points to a PT table or, with the HUGE bit set,
+ * maps a whole PT worth of pages (2MB) to a run of contiguous frames.
+ * Table pointers never reach bit 63 so both kinds can share the slot.
+ */
+#define PAGING64_HUGE_PGNUM    PAGING64_PT_SZ
+#define PAGING64_HUGE_PAGESZ   (PAGING64_HUGE_PGNUM * PAGING64_PAGESZ)
+#define PAGING64_PMD_HUGE_MASK BIT_ULL(63)
+#define PAGING64_PMD_HUGE(ent) ((ent) & PAGING64_PMD_HUGE_MASK)
+#define PAGING64_HUGE_ALIGNED(addr) (((addr) & (PAGING64_HUGE_PAGESZ - 1)) == 0)
+
 
 
 #endif
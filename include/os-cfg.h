@@ -15,6 +15,9 @@
 #define MAX_PRIO 140
 
 #define MM_PAGING
+#define MM_DEMAND_PAGING 1 /* bind frames on first touch instead of at alloc */
+#define MM_KSWAPD 1 /* reclaim RAM frames in the background with -k */
+#define MM_ZSWAP 1 /* keep swapped out pages compressed in memory first */
 //#define MM_FIXED_MEMSZ
 //#define VMDBG 1
 //#define MMDBG 1
@@ -12,10 +12,12 @@
 #define OSMM_H
 
 #include <stdint.h>
+#include <sys/types.h> /* pthread_mutex_t, pthread.h would pull our sched.h */
 
 #define MM_PAGING
 #define PAGING_MAX_MMSWP 4 /* max number of supported swapped space */
-#define PAGING_MAX_SYMTBL_SZ 30
+#define PAGING_SYMTBL_INIT_SZ 32 /* region handles, the table grows on demand */
+#define PAGING_MAX_SYMTBL_SZ (1 << 20)
 
 /* 
  * @bksysnet: in long address mode of 64bit or original 32bit
@@ -30,6 +32,8 @@
 
 typedef char BYTE;
 typedef ADDR_TYPE addr_t;
+/* Page table entries are as wide as the address mode */
+typedef ADDR_TYPE pte_t;
 //typedef unsigned int uint32_t;
 
 
@@ -50,6 +54,18 @@ struct pgn_t{
    struct pgn_t *pg_next; 
 };
 
+/*
+ * Paging counters of a process
+ */
+struct pgrepl_stat {
+   unsigned long access;   /* reads and writes */
+   unsigned long fault;    /* pages that had to be brought into RAM */
+   unsigned long majfault; /* of which read back from swap */
+   unsigned long evict;    /* pages pushed out to swap */
+   unsigned long clean;    /* of which still had a current swap copy */
+   unsigned long readahead; /* swapped pages read in ahead of a fault */
+};
+
 /*
  *  Memory region struct
  */
@@ -58,8 +74,38 @@ struct vm_rg_struct {
    addr_t rg_end;
 
    struct vm_rg_struct *rg_next;
+
+   /* Free region links, size class list and boundary hash chains */
+   struct vm_rg_struct *rg_prev;
+   struct vm_rg_struct *rg_snext;
+   struct vm_rg_struct *rg_enext;
 };
 
+/* Free regions of an area are binned by size class, class k holds the
+ * sizes in [2^k, 2^(k+1)), and hashed by both of their ends */
+#define VM_FREERG_NCLASS 64
+#define VM_FREERG_HASHSZ 64
+
+/* Small objects of 16 bytes up to 2KB are packed in slab pages (libmem) */
+#define VM_SLAB_NCLASS 8
+
+/* Every space starts with a heap growing up from 0 and a stack growing
+ * down from VM_STACK_TOP, anonymous mappings are placed downwards from
+ * VM_MMAP_BASE and take the next ids */
+#define VM_HEAP_ID 0
+#define VM_STACK_ID 1
+#define VM_STACK_TOP (1ULL << 47)
+#define VM_MMAP_BASE (1ULL << 46)
+#define VM_AREA_INIT_CAP 8
+
+/* Area flags */
+#define VM_GROWSDOWN 0x1 /* sbrk is vm_start, the area grows below it */
+#define VM_SHARED    0x2 /* frames come from a shared segment (mm-shm.c)
+                            * or the page cache (mm-filemap.c) */
+
+struct shm_segment;
+struct pgcache_file;
+
 /*
  *  Memory area struct
  */
@@ -69,12 +115,20 @@ struct vm_area_struct {    // dai dien cho tung vung cap phat, heap, stack, code
    addr_t vm_end;
 
    addr_t sbrk;
+   unsigned long vm_flags;
 /*
  * Derived field
  * unsigned long vm_limit = vm_end - vm_start
  */
    struct mm_struct *vm_mm;               
-   struct vm_rg_struct *vm_freerg_list;   // danh sach cac free region ben trong [vmstart,sbrk]
+   /* Free regions inside [vmstart,sbrk] (mm-vm.c) */
+   struct vm_rg_struct *vm_freerg_bin[VM_FREERG_NCLASS];
+   uint64_t vm_freerg_mask; /* classes with a free region */
+   struct vm_rg_struct *vm_freerg_bystart[VM_FREERG_HASHSZ];
+   struct vm_rg_struct *vm_freerg_byend[VM_FREERG_HASHSZ];
+   struct vm_rg_struct *vm_slab[VM_SLAB_NCLASS]; /* free slab objects */
+   struct shm_segment *vm_shm; /* segment mapped by a VM_SHARED area */
+   struct pgcache_file *vm_file; /* or the file it maps */
    struct vm_area_struct *vm_next;  // danh sach cac vm_area_struct khac
 };
 
@@ -92,13 +146,29 @@ struct mm_struct {
    uint32_t *pgd;
 #endif
 
-   struct vm_area_struct *mmap;
+   struct vm_area_struct *mmap; /* areas in address order */
+
+   /* The same areas sorted by start and by id, searched by halving
+    * (mm-vm.c) */
+   struct vm_area_struct **vma_byaddr;
+   struct vm_area_struct **vma_byid;
+   int vma_cnt, vma_cap;
+   unsigned long vma_next_id;
+   addr_t mmap_base; /* next anonymous mapping ends here */
 
-   /* Currently we support a fixed number of symbol */
-   struct vm_rg_struct symrgtbl[PAGING_MAX_SYMTBL_SZ];
+   /* Region handles, indexed by id and doubled when an id lies past the
+    * end.  Unused ids are linked through the index arrays (libmem.c) */
+   struct vm_rg_struct *symrgtbl;
+   int symrgtbl_sz;
+   int *symrg_fnext, *symrg_fprev; /* -1 ends the list, -2 in use */
+   int symrg_free_head;
 
-   /* list of free page */
-   struct pgn_t *fifo_pgn;
+   /* Resident pages, kept by the replacement policy (mm-replace.c) */
+   void *pgrepl;
+   struct pgrepl_stat pgstat;
+
+   /* Guards areas, regions, page tables and the reclaim list of this mm */
+   pthread_mutex_t mm_lock;
 };
 
 /*
@@ -114,18 +184,74 @@ struct framephy_struct {
    struct mm_struct* owner;
 };
 
+/* Largest block of the frame allocator, 2^10 frames */
+#define MEMPHY_MAX_ORDER 10
+
+/* Request queue of a sequential device, pending page transfers.
+ * Default costs in simulated slots, per frame of seek and of transfer */
+#define MEMPHY_IOQ_MAX 32
+#define MEMPHY_SEEK_COST 1
+#define MEMPHY_XFER_COST 8
+#define MEMPHY_IOSCHED_FIFO  0
+#define MEMPHY_IOSCHED_SCAN  1
+#define MEMPHY_IOSCHED_CLOOK 2
+
+struct memphy_ioreq {
+   addr_t fpn;                /* frame on the device */
+   int wr;
+   BYTE *buf;                 /* data of a write, owned by the queue */
+   struct memphy_struct *peer; /* a read lands in this frame */
+   addr_t peerfpn;
+   unsigned long arrival;     /* device clock when queued */
+   unsigned long seq;         /* queueing order */
+};
+
+/* Cost counters of a sequential device, in simulated slots */
+struct memphy_iostat {
+   unsigned long reads;
+   unsigned long writes;
+   unsigned long seek_frames;  /* cursor travel */
+   unsigned long rd_latency;   /* queueing, seek and transfer of reads */
+   unsigned long wr_latency;
+};
+
 struct memphy_struct {
    /* Basic field of data and size */
    BYTE *storage;  // day la bo nho real cap phat dong
-   int maxsz;
+   uint64_t maxsz;
    
    /* Sequential device fields */ 
    int rdmflg;
-   int cursor;
+   addr_t cursor;
+
+   /* Sequential device cost model and request queue */
+   int iosched;               /* MEMPHY_IOSCHED_*, order requests are served */
+   unsigned long seek_cost;   /* slots per frame the cursor travels */
+   unsigned long xfer_cost;   /* slots per frame transferred */
+   unsigned long io_clock;    /* slots the device spent busy */
+   int io_dir;                /* SCAN direction, 1 up and -1 down */
+   struct memphy_ioreq *ioq;
+   int ioq_cnt;
+   unsigned long ioq_seq;
+   struct memphy_iostat iostat;
 
    /* Management structure */
-   struct framephy_struct *free_fp_list;
    struct framephy_struct *used_fp_list;
+   int free_fp_cnt; /* free frames, listed or fresh */
+
+   /* Buddy allocator, free blocks of 2^order frames per order */
+   addr_t bd_head[MEMPHY_MAX_ORDER + 1];
+   addr_t fp_fresh;     /* largest blocks never handed out, from here ... */
+   addr_t fp_fresh_end; /* ... to here */
+
+   /* Per-frame list links, block orders and reference counts, one chunk
+    * per largest block, created when a frame of it is first used */
+   struct memphy_fpmeta **fp_meta;
+   addr_t fp_meta_cnt;
+
+   /* Guards the frame management fields, the sequential cursor and
+    * the request queue */
+   pthread_mutex_t fp_lock;
 };
 
 #endif OSMM_H
@@ -17,50 +17,302 @@
 #include <stdio.h>
 #include <pthread.h>
 
-static pthread_mutex_t mmvm_lock = PTHREAD_MUTEX_INITIALIZER;
+/*
+ * Slabs: requests up to 2KB are rounded up to a power of two from 16
+ * bytes and served from slabs of a few objects of that size.  Slabs are
+ * cut from the heap pages like any region, so the classes share pages.
+ * Freed objects go back to the list of their class in their area.
+ */
+#define SLAB_MIN_SHIFT 4
+#define SLAB_OBJSZ(cls) ((addr_t)1 << ((cls) + SLAB_MIN_SHIFT))
+#define SLAB_OBJS 4 /* objects per slab, at most a page */
+
+/* __slab_class - slab class of a request, -1 if too large for a slab */
+static int __slab_class(addr_t size)
+{
+  int cls = 0;
+
+  if (size == 0 || size > SLAB_OBJSZ(VM_SLAB_NCLASS - 1))
+    return -1;
+
+  while (SLAB_OBJSZ(cls) < size)
+    cls++;
+
+  return cls;
+}
+
+/* __vma_grow - extend an area by inc bytes
+ * @base: start of the new space, below the old start for a stack */
+static int __vma_grow(struct pcb_t *caller, int vmaid, struct vm_area_struct *vma,
+                      addr_t inc, addr_t *base)
+{
+  addr_t old_sbrk = vma->sbrk;
+
+  if (inc_vma_limit(caller, vmaid, inc) != 0)
+    return -1;
+
+  *base = (vma->vm_flags & VM_GROWSDOWN) ? vma->sbrk : old_sbrk;
+  return 0;
+}
+
+/* __slab_alloc - take an object, carving a new slab if needed */
+static int __slab_alloc(struct pcb_t *caller, int vmaid, addr_t size, struct vm_rg_struct *newrg)
+{
+  struct vm_area_struct *vma = get_vma_by_num(caller->mm, vmaid);
+  int cls = __slab_class(size);
+  struct vm_rg_struct slab, *obj;
+  addr_t slabsz, it;
+
+  if (vma == NULL)
+    return -1;
+
+  if (vma->vm_slab[cls] == NULL)
+  {
+    slabsz = SLAB_OBJSZ(cls) * SLAB_OBJS;
+    if (slabsz > PAGING64_PAGESZ)
+      slabsz = PAGING64_PAGESZ;
+
+    /* A free region, or one more page at sbrk whose rest stays free */
+    if (vm_freerg_get(vma, slabsz, &slab) != 0)
+    {
+      if (__vma_grow(caller, vmaid, vma, PAGING64_PAGESZ, &slab.rg_start) != 0)
+        return -1;
+      slab.rg_end = slab.rg_start + slabsz;
+      vm_freerg_put(vma, slab.rg_end, slab.rg_start + PAGING64_PAGESZ);
+    }
 
-/* enlist_vm_freerg_list - add new rg to freerg_list */
+    /* Lowest objects on top, the slab fills front to back */
+    for (it = slab.rg_end; it >= slab.rg_start + SLAB_OBJSZ(cls); )
+    {
+      it -= SLAB_OBJSZ(cls);
+      enlist_vm_rg_node(&vma->vm_slab[cls], init_vm_rg(it, it + SLAB_OBJSZ(cls)));
+    }
+  }
+
+  obj = vma->vm_slab[cls];
+  vma->vm_slab[cls] = obj->rg_next;
+  newrg->rg_start = obj->rg_start;
+  newrg->rg_end = obj->rg_start + size;
+  free(obj);
+
+  return 0;
+}
+
+/* enlist_vm_freerg_list - give rg back to the free regions of its own area,
+ * or to its slab list when it is a slab object */
 int enlist_vm_freerg_list(struct mm_struct *mm, struct vm_rg_struct *rg_elmt)
 {
-  struct vm_rg_struct *rg_node = mm->mmap->vm_freerg_list;
+  struct vm_area_struct *vma = get_vma_by_addr(mm, rg_elmt->rg_start);
+  int cls = __slab_class(rg_elmt->rg_end - rg_elmt->rg_start);
 
-  if (rg_elmt->rg_start >= rg_elmt->rg_end)
+  if (vma == NULL)
+  {
+    free(rg_elmt);
     return -1;
+  }
+
+  /* A shared segment stays mapped, only the handle goes */
+  if (vma->vm_flags & VM_SHARED)
+  {
+    free(rg_elmt);
+    return 0;
+  }
 
-  if (rg_node != NULL)
-    rg_elmt->rg_next = rg_node;
+  if (cls >= 0)
+  {
+    rg_elmt->rg_end = rg_elmt->rg_start + SLAB_OBJSZ(cls);
+    return enlist_vm_rg_node(&vma->vm_slab[cls], rg_elmt);
+  }
 
-  mm->mmap->vm_freerg_list = rg_elmt;
+  vm_freerg_put(vma, rg_elmt->rg_start, rg_elmt->rg_end);
+  free(rg_elmt);
   return 0;
 }
 
 /* get_symrg_byid - get mem region by region ID */
 struct vm_rg_struct *get_symrg_byid(struct mm_struct *mm, int rgid)
 {
-  if (rgid < 0 || rgid > PAGING_MAX_SYMTBL_SZ)
+  if (rgid < 0 || rgid >= mm->symrgtbl_sz)
     return NULL;
 
   return &mm->symrgtbl[rgid];
 }
 
+static void __symrg_link(struct mm_struct *mm, int rgid)
+{
+  int head = mm->symrg_free_head;
+
+  mm->symrg_fnext[rgid] = head;
+  mm->symrg_fprev[rgid] = -1;
+  if (head >= 0)
+    mm->symrg_fprev[head] = rgid;
+  mm->symrg_free_head = rgid;
+}
+
+static void __symrg_unlink(struct mm_struct *mm, int rgid)
+{
+  int next = mm->symrg_fnext[rgid];
+  int prev = mm->symrg_fprev[rgid];
+
+  if (next == -2)
+    return; /* already in use */
+
+  if (prev >= 0)
+    mm->symrg_fnext[prev] = next;
+  else
+    mm->symrg_free_head = next;
+  if (next >= 0)
+    mm->symrg_fprev[next] = prev;
+  mm->symrg_fnext[rgid] = mm->symrg_fprev[rgid] = -2;
+}
+
+/* __symrg_set - bind region ID rgid, which fits the table, to a range */
+static void __symrg_set(struct mm_struct *mm, int rgid, addr_t start, addr_t end)
+{
+  __symrg_unlink(mm, rgid);
+  mm->symrgtbl[rgid].rg_start = start;
+  mm->symrgtbl[rgid].rg_end = end;
+}
+
+/* __symrg_grow - make room for region ID rgid in the handle table */
+static int __symrg_grow(struct mm_struct *mm, int rgid)
+{
+  struct vm_rg_struct *tbl;
+  int *fnext, *fprev;
+  int oldsz = mm->symrgtbl_sz;
+  int sz = (oldsz > 0) ? oldsz : PAGING_SYMTBL_INIT_SZ;
+  int it;
+
+  if (rgid < 0 || rgid >= PAGING_MAX_SYMTBL_SZ)
+    return -1;
+  if (rgid < oldsz)
+    return 0;
+
+  while (sz <= rgid)
+    sz *= 2;
+  if (sz > PAGING_MAX_SYMTBL_SZ)
+    sz = PAGING_MAX_SYMTBL_SZ;
+
+  tbl = realloc(mm->symrgtbl, sz * sizeof(struct vm_rg_struct));
+  fnext = realloc(mm->symrg_fnext, sz * sizeof(int));
+  fprev = realloc(mm->symrg_fprev, sz * sizeof(int));
+  if (tbl != NULL) mm->symrgtbl = tbl;
+  if (fnext != NULL) mm->symrg_fnext = fnext;
+  if (fprev != NULL) mm->symrg_fprev = fprev;
+  if (tbl == NULL || fnext == NULL || fprev == NULL)
+    return -1;
+
+  /* New ids are free, the lowest ends up first */
+  memset(tbl + oldsz, 0, (sz - oldsz) * sizeof(struct vm_rg_struct));
+  for (it = sz - 1; it >= oldsz; it--)
+    __symrg_link(mm, it);
+
+  mm->symrgtbl_sz = sz;
+  return 0;
+}
+
+/*
+ * symrg_init - give an mm its initial region handle table
+ */
+int symrg_init(struct mm_struct *mm)
+{
+  mm->symrgtbl = NULL;
+  mm->symrg_fnext = mm->symrg_fprev = NULL;
+  mm->symrgtbl_sz = 0;
+  mm->symrg_free_head = -1;
+
+  return __symrg_grow(mm, PAGING_SYMTBL_INIT_SZ - 1);
+}
+
+/*
+ * symrg_dup - copy the region handles of another mm
+ */
+int symrg_dup(struct mm_struct *mm, struct mm_struct *src)
+{
+  int sz = src->symrgtbl_sz;
+
+  mm->symrgtbl = malloc(sz * sizeof(struct vm_rg_struct));
+  mm->symrg_fnext = malloc(sz * sizeof(int));
+  mm->symrg_fprev = malloc(sz * sizeof(int));
+  memcpy(mm->symrgtbl, src->symrgtbl, sz * sizeof(struct vm_rg_struct));
+  memcpy(mm->symrg_fnext, src->symrg_fnext, sz * sizeof(int));
+  memcpy(mm->symrg_fprev, src->symrg_fprev, sz * sizeof(int));
+  mm->symrgtbl_sz = sz;
+  mm->symrg_free_head = src->symrg_free_head;
+
+  return 0;
+}
+
+void symrg_release(struct mm_struct *mm)
+{
+  free(mm->symrgtbl);
+  free(mm->symrg_fnext);
+  free(mm->symrg_fprev);
+  mm->symrgtbl = NULL;
+  mm->symrg_fnext = mm->symrg_fprev = NULL;
+  mm->symrgtbl_sz = 0;
+  mm->symrg_free_head = -1;
+}
+
+/* symrg_bind - bind region ID rgid to [start,end), growing the table */
+int symrg_bind(struct mm_struct *mm, int rgid, addr_t start, addr_t end)
+{
+  if (__symrg_grow(mm, rgid) != 0)
+    return -1;
+
+  __symrg_set(mm, rgid, start, end);
+  return 0;
+}
+
+/* symrg_get_free - an unused region ID, the table grows when all are taken */
+int symrg_get_free(struct mm_struct *mm)
+{
+  if (mm->symrg_free_head < 0 &&
+      __symrg_grow(mm, mm->symrgtbl_sz) != 0)
+    return -1;
+
+  return mm->symrg_free_head;
+}
+
 /* __alloc - allocate a region memory */
 int __alloc(struct pcb_t *caller, int vmaid, int rgid, addr_t size, addr_t *alloc_addr)
 {
-  pthread_mutex_lock(&mmvm_lock);
+  pthread_mutex_lock(&caller->mm->mm_lock);
   struct vm_rg_struct rgnode;
   
   /* FIX: Dùng caller->mm */
   struct vm_area_struct *cur_vma = get_vma_by_num(caller->mm, vmaid);
   int inc_sz = 0;
 
+  if (cur_vma == NULL || __symrg_grow(caller->mm, rgid) != 0)
+  {
+    pthread_mutex_unlock(&caller->mm->mm_lock);
+    return -1;
+  }
+
+  /* 0. Small requests share slab pages */
+  if (__slab_class(size) >= 0)
+  {
+    if (__slab_alloc(caller, vmaid, size, &rgnode) != 0)
+    {
+      pthread_mutex_unlock(&caller->mm->mm_lock);
+      return -1;
+    }
+
+    __symrg_set(caller->mm, rgid, rgnode.rg_start, rgnode.rg_end);
+
+    *alloc_addr = rgnode.rg_start;
+    pthread_mutex_unlock(&caller->mm->mm_lock);
+    return 0;
+  }
+
   /* 1. Thử tái sử dụng vùng nhớ cũ */
   if (get_free_vmrg_area(caller, vmaid, size, &rgnode) == 0)
   {
-    caller->mm->symrgtbl[rgid].rg_start = rgnode.rg_start;
-    caller->mm->symrgtbl[rgid].rg_end = rgnode.rg_end;
+    __symrg_set(caller->mm, rgid, rgnode.rg_start, rgnode.rg_end);
  
     *alloc_addr = rgnode.rg_start;
-    pthread_mutex_unlock(&mmvm_lock);
+    pthread_mutex_unlock(&caller->mm->mm_lock);
     return 0;
   }
 
@@ -77,39 +329,40 @@ int __alloc(struct pcb_t *caller, int vmaid, int rgid, addr_t size, addr_t *allo
   int inc_amt = inc_sz;
 #endif
   
-  int old_sbrk = cur_vma->sbrk;
+  addr_t base;
 
   /* WORKAROUND: Gọi trực tiếp hàm kernel (Bypass Syscall) để tránh lỗi tìm PCB */
   /* Thay vì: syscall(caller->krnl, caller->pid, 17, &regs); */
-  inc_vma_limit(caller, vmaid, inc_amt);
+  if (__vma_grow(caller, vmaid, cur_vma, inc_amt, &base) != 0)
+  {
+    pthread_mutex_unlock(&caller->mm->mm_lock);
+    return -1;
+  }
 
   /* Cập nhật Symbol Table */
-  caller->mm->symrgtbl[rgid].rg_start = old_sbrk;
-  caller->mm->symrgtbl[rgid].rg_end = old_sbrk + size;
+  __symrg_set(caller->mm, rgid, base, base + size);
+
+  /* The rest of the last page is free for the next allocations */
+  if (size < inc_amt)
+    vm_freerg_put(cur_vma, base + size, base + inc_amt);
 
-  *alloc_addr = old_sbrk;
+  *alloc_addr = base;
 
-  pthread_mutex_unlock(&mmvm_lock);
+  pthread_mutex_unlock(&caller->mm->mm_lock);
   return 0;
 }
 
 /* __free - remove a region memory */
 int __free(struct pcb_t *caller, int vmaid, int rgid)
 {
-  pthread_mutex_lock(&mmvm_lock);
-
-  if (rgid < 0 || rgid > PAGING_MAX_SYMTBL_SZ)
-  {
-    pthread_mutex_unlock(&mmvm_lock);
-    return -1;
-  }
+  pthread_mutex_lock(&caller->mm->mm_lock);
 
   /* FIX: Dùng caller->mm */
   struct vm_rg_struct *rgnode = get_symrg_byid(caller->mm, rgid);
 
-  if (rgnode->rg_start == 0 && rgnode->rg_end == 0)
+  if (rgnode == NULL || (rgnode->rg_start == 0 && rgnode->rg_end == 0))
   {
-    pthread_mutex_unlock(&mmvm_lock);
+    pthread_mutex_unlock(&caller->mm->mm_lock);
     return -1;
   }
   
@@ -120,11 +373,12 @@ int __free(struct pcb_t *caller, int vmaid, int rgid)
 
   rgnode->rg_start = rgnode->rg_end = 0;
   rgnode->rg_next = NULL;
+  __symrg_link(caller->mm, rgid);
 
   /* FIX: Dùng caller->mm */
   enlist_vm_freerg_list(caller->mm, freerg_node);
 
-  pthread_mutex_unlock(&mmvm_lock);
+  pthread_mutex_unlock(&caller->mm->mm_lock);
   return 0;
 }
 
@@ -166,74 +420,434 @@ int libfree(struct pcb_t *proc, uint32_t reg_index)
   return 0;
 }
 
-/* pg_getpage - get the page in ram */
-int pg_getpage(struct mm_struct *mm, int pgn, int *fpn, struct pcb_t *caller)
+/* __pg_zero_frames - clear a run of RAM frames before handing them out */
+static void __pg_zero_frames(struct pcb_t *caller, addr_t fpn, int num)
 {
-  uint32_t pte = pte_get_entry(caller, pgn);
+  static const BYTE zero[PAGING64_PAGESZ];
+  int i;
 
-  if (!PAGING_PAGE_PRESENT(pte))
-  { 
-    addr_t vicpgn, swpfpn, vicfpn;
-    uint32_t vicpte;
+  for (i = 0; i < num; i++)
+    MEMPHY_write_page(caller->krnl->mram, fpn + i, zero);
+}
 
-    if (find_victim_page(caller->mm, &vicpgn) == -1) return -1;
+/*
+ * __evict_shared - take a segment or file page out of this space only
+ * A segment swaps its page out once no space maps it any more, file
+ * pages stay in the page cache.  Returns -1 and leaves the page mapped
+ * if a segment page has no swap slot to go to.
+ */
+static int __evict_shared(struct pcb_t *caller, addr_t vicpgn, addr_t vicfpn)
+{
+  struct vm_area_struct *vma = get_vma_by_addr(caller->mm, vicpgn * PAGING64_PAGESZ);
+  addr_t swpfpn = 0;
+  int swptyp = -1;
+
+  if (vma == NULL)
+    return -1;
+
+  if (vma->vm_file != NULL)
+  {
+    pte_set_entry(caller, vicpgn, 0);
+    MEMPHY_put_freefp(caller->krnl->mram, vicfpn);
+  }
+  else
+  {
+    if (swap_get_slot(&swptyp, &swpfpn) != 0)
+      return -1;
+
+    pte_set_entry(caller, vicpgn, 0);
+    if (shm_putpage(caller->krnl->mram, vma->vm_shm,
+                    vicpgn - vma->vm_start / PAGING64_PAGESZ,
+                    vicfpn, swptyp, swpfpn) == 0 && swptyp >= 0)
+      swap_put_slot(swptyp, swpfpn);
+  }
+  caller->mm->pgstat.evict++;
+
+  return 0;
+}
+
+/* __evict_batch - victims per eviction, small RAMs evict one by one */
+static int __evict_batch(struct pcb_t *caller)
+{
+  int n = caller->krnl->mram->maxsz / PAGING64_PAGESZ / 16;
+
+  if (n < 1)
+    return 1;
+  return (n > SWAP_CLUSTER_PAGES) ? SWAP_CLUSTER_PAGES : n;
+}
+
+/*
+ * pg_evict - push victim pages out to swap and drop their frames
+ * A batch of victims goes to contiguous swap slots in page order, so a
+ * fault on one of them can read its neighbours back along with it.
+ * Clean pages whose swap copy is still current are not written at all.
+ */
+int pg_evict(struct pcb_t *caller)
+{
+  struct memphy_struct *mram = caller->krnl->mram;
+  addr_t vicpgn[SWAP_CLUSTER_PAGES];
+  addr_t skipped[SWAP_CLUSTER_PAGES];
+  addr_t pgn, swpfpn, vicfpn;
+  pte_t vicpte;
+  int batch = __evict_batch(caller);
+  int nr = 0, done = 0, nskip = 0;
+  int i, j, got, swptyp;
+  int shrunk = 0;
+
+  while (nr + done < batch && find_victim_page(caller->mm, &pgn) == 0)
+  {
+    /* A victim inside a huge mapping resolves to its own 4KB frame,
+     * the walker splits the mapping when its PTE gets updated */
+    vicpte = pte_get_entry(caller, pgn);
+    if (!PAGING_PAGE_PRESENT(vicpte))
+    {
+      done++;
+      continue;
+    }
 
-    if (MEMPHY_get_freefp(caller->krnl->active_mswp, &swpfpn) == -1) return -1;
+    if (PAGING_PAGE_SHM(vicpte))
+    {
+      if (__evict_shared(caller, pgn, PAGING_FPN(vicpte)) == 0)
+        done++;
+      else if (nskip < SWAP_CLUSTER_PAGES)
+        skipped[nskip++] = pgn;
+      else
+      { /* Too many pages that cannot go, keep the rest for later */
+        pgrepl_add(caller->mm, pgn);
+        break;
+      }
+      continue;
+    }
 
-    vicpte = pte_get_entry(caller, vicpgn);
     vicfpn = PAGING_FPN(vicpte);
+    if (!(vicpte & PAGING_PTE_DIRTY_MASK) &&
+        swap_cache_get(vicfpn, &swptyp, &swpfpn) == 0)
+    {
+      pte_set_swap(caller, pgn, swptyp, swpfpn);
+      swap_free_frame(mram, vicfpn);
+      caller->mm->pgstat.evict++;
+      caller->mm->pgstat.clean++;
+      done++;
+      continue;
+    }
 
-    __swap_cp_page(caller->krnl->active_mswp, swpfpn, caller->krnl->mram, vicfpn);
+    for (i = nr; i > 0 && vicpgn[i - 1] > pgn; i--)
+      vicpgn[i] = vicpgn[i - 1];
+    vicpgn[i] = pgn;
+    nr++;
+  }
 
-    pte_set_swap(caller, vicpgn, 0, swpfpn);
+  /* Victims that could not go out stay candidates for the next round */
+  for (i = 0; i < nskip; i++)
+    pgrepl_add(caller->mm, skipped[i]);
 
-    if (PAGING_PAGE_SWAPPED(pte)) {
-        int old_swpfpn = PAGING_SWP(pte);
-        __swap_cp_page(caller->krnl->mram, vicfpn, caller->krnl->active_mswp, old_swpfpn);
-        MEMPHY_put_freefp(caller->krnl->active_mswp, old_swpfpn);
-    } 
+  if (nr + done == 0)
+    return -1;
 
-    pte_set_fpn(caller, pgn, vicfpn);
-    enlist_pgn_node(&caller->mm->fifo_pgn, pgn);
+  for (i = 0; i < nr; i += got)
+  {
+    got = swap_get_cluster(nr - i, &swptyp, &swpfpn);
+    if (got == 0 && !shrunk++ && swap_cache_shrink() > 0)
+    { /* Slots kept for resident pages are the first to give back */
+      got = swap_get_cluster(nr - i, &swptyp, &swpfpn);
+    }
+    if (got == 0)
+    { /* Swap is full, the rest stays resident */
+      for (j = i; j < nr; j++)
+        pgrepl_add(caller->mm, vicpgn[j]);
+      swap_unplug();
+      return (i + done > 0) ? 0 : -1;
+    }
+
+    for (j = 0; j < got; j++)
+    {
+      vicfpn = PAGING_FPN(pte_get_entry(caller, vicpgn[i + j]));
+      swap_submit_write(mram, vicfpn, swptyp, swpfpn + j);
+      pte_set_swap(caller, vicpgn[i + j], swptyp, swpfpn + j);
+
+      /* A frame still shared copy-on-write stays with its other users */
+      swap_free_frame(mram, vicfpn);
+      caller->mm->pgstat.evict++;
+    }
   }
 
+  /* The whole batch goes to the devices in one go */
+  swap_unplug();
+  return 0;
+}
+
+/*
+ * __swap_readahead - read back the neighbours of a swapped in page
+ * Pages next to pgn whose slots continue the run of its slot were
+ * evicted in the same batch.  Only free frames are used, the pages keep
+ * their slots in the swap cache.  The reads are only queued, the caller
+ * unplugs them.
+ */
+static void __swap_readahead(struct pcb_t *caller, addr_t pgn, int swptyp, addr_t swpfpn)
+{
+  addr_t q, fpn;
+  pte_t pte;
+  int dir, n = 1;
+
+  for (dir = 1; dir >= -1; dir -= 2)
+    for (q = pgn + dir; n < SWAP_CLUSTER_PAGES; q += dir, n++)
+    {
+      pte = pte_get_entry(caller, q);
+      if (PAGING_PAGE_PRESENT(pte) || !PAGING_PAGE_SWAPPED(pte) ||
+          PAGING_SWPTYP(pte) != swptyp || PAGING_SWP(pte) != swpfpn + (q - pgn))
+        break;
+      if (MEMPHY_get_freefp(caller->krnl->mram, &fpn) != 0)
+        return;
+
+      swap_submit_read(caller->krnl->mram, fpn, swptyp, PAGING_SWP(pte));
+      swap_cache_add(fpn, swptyp, PAGING_SWP(pte));
+      pte_set_fpn(caller, q, fpn);
+      pgrepl_add(caller->mm, q);
+      caller->mm->pgstat.readahead++;
+    }
+}
+
+/* __pg_getframe - get a free RAM frame, evicting victim pages if RAM is full */
+static int __pg_getframe(struct pcb_t *caller, addr_t *retfpn)
+{
+  /* Cached file pages nobody maps go first, they need no write */
+  while (MEMPHY_get_freefp(caller->krnl->mram, retfpn) != 0)
+    if (pgcache_shrink(caller->krnl->mram) != 0 && pg_evict(caller) != 0)
+      return -1;
+
+  /* Let the daemon refill RAM before the next fault has to evict */
+  kswapd_wakeup(caller->krnl->mram);
+  return 0;
+}
+
+/* __pg_shm_fault - map the frame of a shared segment page */
+static int __pg_shm_fault(struct pcb_t *caller, struct vm_area_struct *vma, addr_t pgn)
+{
+  addr_t newfpn, fpn;
+  pte_t pte;
+  int used;
+
+  if (__pg_getframe(caller, &newfpn) != 0) return -1;
+
+  used = shm_getpage(caller->krnl->mram, vma->vm_shm,
+                     pgn - vma->vm_start / PAGING64_PAGESZ, newfpn, &fpn);
+  if (used <= 0)
+    MEMPHY_put_freefp(caller->krnl->mram, newfpn);
+  if (used < 0) return -1;
+
+  pte_set_fpn(caller, pgn, fpn);
+  pte = pte_get_entry(caller, pgn);
+  SETBIT(pte, PAGING_PTE_SHM_MASK);
+  pte_set_entry(caller, pgn, pte);
+  pgrepl_add(caller->mm, pgn);
+
+  if (used == 2)
+    caller->mm->pgstat.majfault++;
+  return 0;
+}
+
+/* __pg_file_fault - map the cached frame of a file page, read-only */
+static int __pg_file_fault(struct pcb_t *caller, struct vm_area_struct *vma, addr_t pgn)
+{
+  addr_t newfpn, fpn;
+  pte_t pte;
+  int used;
+
+  if (__pg_getframe(caller, &newfpn) != 0) return -1;
+
+  used = filemap_getpage(caller->krnl->mram, vma->vm_file,
+                         pgn - vma->vm_start / PAGING64_PAGESZ, newfpn, &fpn);
+  if (used <= 0)
+    MEMPHY_put_freefp(caller->krnl->mram, newfpn);
+  if (used < 0) return -1;
+
+  /* Writes fault again and copy the page like copy-on-write */
+  pte_set_fpn(caller, pgn, fpn);
+  pte = pte_get_entry(caller, pgn);
+  SETBIT(pte, PAGING_PTE_SHM_MASK);
+  SETBIT(pte, PAGING_PTE_WRPROT_MASK);
+  pte_set_entry(caller, pgn, pte);
+  pgrepl_add(caller->mm, pgn);
+
+  return 0;
+}
+
+/* pg_getpage - get the page in ram
+ * @wrflg: the access is a write, read-only mappings must be resolved
+ */
+int pg_getpage(struct mm_struct *mm, addr_t pgn, addr_t *fpn, int wrflg, struct pcb_t *caller)
+{
+  pte_t pte = pte_get_entry(caller, pgn);
+  addr_t newfpn;
+  int added = 0; /* the page joined the replacement policy */
+
+  if (!PAGING_PAGE_PRESENT(pte) && !PAGING_PAGE_SWAPPED(pte))
+  { /* Never touched: only valid inside a vm area */
+    addr_t addr = pgn * PAGING64_PAGESZ;
+    addr_t hugeaddr = addr & ~(addr_t)(PAGING64_HUGE_PAGESZ - 1);
+    struct vm_area_struct *vma = get_vma_by_addr(mm, addr);
+
+    if (vma == NULL) return -1;
+
+    if (vma->vm_shm != NULL)
+    { /* Shared pages come from their segment, never from the zero frame */
+      if (__pg_shm_fault(caller, vma, pgn) != 0) return -1;
+      added = 1;
+    }
+    else if (vma->vm_file != NULL)
+    { /* File pages come from the page cache, a write then copies it */
+      if (__pg_file_fault(caller, vma, pgn) != 0) return -1;
+      if (wrflg)
+      {
+        mm->pgstat.fault++;
+        return pg_getpage(mm, pgn, fpn, wrflg, caller);
+      }
+      added = 1;
+    }
+    else if (!wrflg && caller->krnl->zero_fpn != PAGING_FPN_INVALID)
+    { /* Reads share the zero frame until the first write */
+      pte_set_fpn(caller, pgn, caller->krnl->zero_fpn);
+      pte = pte_get_entry(caller, pgn);
+      SETBIT(pte, PAGING_PTE_WRPROT_MASK);
+      pte_set_entry(caller, pgn, pte);
+    }
+    else if (hugeaddr >= vma->vm_start &&
+             hugeaddr + PAGING64_HUGE_PAGESZ <= vma->vm_end &&
+             vmap_huge_page(caller, hugeaddr) == 0)
+    { /* The whole 2MB block belongs to the area, back it with a huge page */
+      pte = pte_get_entry(caller, pgn);
+      __pg_zero_frames(caller, PAGING_FPN(pte) - pgn % PAGING64_HUGE_PGNUM,
+                       PAGING64_HUGE_PGNUM);
+      added = 1;
+    }
+    else
+    {
+      if (__pg_getframe(caller, &newfpn) != 0) return -1;
+      __pg_zero_frames(caller, newfpn, 1);
+      pte_set_fpn(caller, pgn, newfpn);
+      pgrepl_add(caller->mm, pgn);
+      added = 1;
+    }
+  }
+  else if (!PAGING_PAGE_PRESENT(pte))
+  { /* Swapped out: bring the page back in, clean, its slot stays cached */
+    addr_t swpfpn = PAGING_SWP(pte);
+    int swptyp = PAGING_SWPTYP(pte);
+
+    if (__pg_getframe(caller, &newfpn) != 0) return -1;
+
+    swap_submit_read(caller->krnl->mram, newfpn, swptyp, swpfpn);
+    swap_cache_add(newfpn, swptyp, swpfpn);
+
+    pte_set_fpn(caller, pgn, newfpn);
+    pgrepl_add(caller->mm, pgn);
+    added = 1;
+    mm->pgstat.majfault++;
+    __swap_readahead(caller, pgn, swptyp, swpfpn);
+    swap_unplug();
+  }
+  else if (wrflg && PAGING_PAGE_WRPROT(pte))
+  { /* Write to a shared frame: the zero frame or a copy-on-write one */
+    addr_t oldfpn = PAGING_FPN(pte);
+
+    if (oldfpn == caller->krnl->zero_fpn)
+    {
+      if (__pg_getframe(caller, &newfpn) != 0) return -1;
+      __pg_zero_frames(caller, newfpn, 1);
+      pte_set_fpn(caller, pgn, newfpn);
+      pgrepl_add(caller->mm, pgn);
+      added = 1;
+    }
+    else if (MEMPHY_refcnt_fp(caller->krnl->mram, oldfpn) == 1)
+    { /* Last user keeps the frame */
+      CLRBIT(pte, PAGING_PTE_WRPROT_MASK);
+      pte_set_entry(caller, pgn, pte);
+    }
+    else
+    {
+      /* Pin the shared frame, finding a new one may evict this very page */
+      MEMPHY_ref_fp(caller->krnl->mram, oldfpn);
+      if (__pg_getframe(caller, &newfpn) != 0) {
+        swap_free_frame(caller->krnl->mram, oldfpn);
+        return -1;
+      }
+
+      if (pte_get_entry(caller, pgn) != pte) {
+        MEMPHY_put_freefp(caller->krnl->mram, newfpn);
+        swap_free_frame(caller->krnl->mram, oldfpn);
+        return pg_getpage(mm, pgn, fpn, wrflg, caller);
+      }
+
+      __swap_cp_page(caller->krnl->mram, oldfpn, caller->krnl->mram, newfpn);
+      pte_set_fpn(caller, pgn, newfpn);
+
+      /* Drop the pin and this space's own reference */
+      swap_free_frame(caller->krnl->mram, oldfpn);
+      swap_free_frame(caller->krnl->mram, oldfpn);
+    }
+  }
+
+  /* The policy decides how a page it just got starts out,
+   * any other access marks the page referenced */
+  if (added)
+    mm->pgstat.fault++;
+  else
+    pte_mkyoung(mm, pgn);
+
   *fpn = PAGING_FPN(pte_get_entry(caller,pgn));
   return 0;
 }
 
 /* pg_getval - read value at given offset */
-int pg_getval(struct mm_struct *mm, int addr, BYTE *data, struct pcb_t *caller)
+int pg_getval(struct mm_struct *mm, addr_t addr, BYTE *data, struct pcb_t *caller)
 {
-  int pgn = PAGING_PGN(addr);
-  int off = PAGING_OFFST(addr);
-  int fpn;
+#ifdef MM64
+  addr_t pgn = PAGING64_ADDR_PGN(addr);
+  addr_t off = PAGING64_ADDR_OFFST(addr);
+#else
+  addr_t pgn = PAGING_PGN(addr);
+  addr_t off = PAGING_OFFST(addr);
+#endif
+  addr_t fpn;
 
-  if (pg_getpage(mm, pgn, &fpn, caller) != 0) return -1; 
+  if (pg_getpage(mm, pgn, &fpn, 0, caller) != 0) return -1; 
+  mm->pgstat.access++;
 
   /* FIX: Tính địa chỉ vật lý cho 64-bit page size */
 #ifdef MM64
-  int phyaddr = (fpn * PAGING64_PAGESZ) + off;
+  addr_t phyaddr = (fpn * PAGING64_PAGESZ) + off;
 #else
-  int phyaddr = (fpn << PAGING_ADDR_FPN_LOBIT) + off;
+  addr_t phyaddr = (fpn << PAGING_ADDR_FPN_LOBIT) + off;
 #endif
 
   MEMPHY_read(caller->krnl->mram, phyaddr, data);
   return 0;
 }
 
-/* pg_setval - write value to given offset */
-int pg_setval(struct mm_struct *mm, int addr, BYTE value, struct pcb_t *caller)
+/* pg_setval - write value to given offset
+ * The first write makes the page dirty, its swap copy is stale from now.
+ */
+int pg_setval(struct mm_struct *mm, addr_t addr, BYTE value, struct pcb_t *caller)
 {
-  int pgn = PAGING_PGN(addr);
-  int off = PAGING_OFFST(addr);
-  int fpn;
+#ifdef MM64
+  addr_t pgn = PAGING64_ADDR_PGN(addr);
+  addr_t off = PAGING64_ADDR_OFFST(addr);
+#else
+  addr_t pgn = PAGING_PGN(addr);
+  addr_t off = PAGING_OFFST(addr);
+#endif
+  addr_t fpn;
+
+  if (pg_getpage(mm, pgn, &fpn, 1, caller) != 0) return -1; 
+  mm->pgstat.access++;
 
-  if (pg_getpage(mm, pgn, &fpn, caller) != 0) return -1; 
+  if (pte_mkdirty(mm, pgn))
+    swap_cache_drop(fpn);
 
 #ifdef MM64
-  int phyaddr = (fpn * PAGING64_PAGESZ) + off;
+  addr_t phyaddr = (fpn * PAGING64_PAGESZ) + off;
 #else
-  int phyaddr = (fpn << PAGING_ADDR_FPN_LOBIT) + off;
+  addr_t phyaddr = (fpn << PAGING_ADDR_FPN_LOBIT) + off;
 #endif
 
   MEMPHY_write(caller->krnl->mram, phyaddr, value);
@@ -244,12 +858,22 @@ int pg_setval(struct mm_struct *mm, int addr, BYTE value, struct pcb_t *caller)
 int __read(struct pcb_t *caller, int vmaid, int rgid, addr_t offset, BYTE *data)
 {
   /* FIX: Dùng caller->mm */
-  struct vm_rg_struct *currg = get_symrg_byid(caller->mm, rgid);
-  if (currg == NULL) return -1;
+  struct vm_rg_struct *currg;
+  int ret;
+
+  /* A read may fault pages in, it takes the same lock as writes */
+  pthread_mutex_lock(&caller->mm->mm_lock);
+  currg = get_symrg_byid(caller->mm, rgid);
+  if (currg == NULL) {
+    pthread_mutex_unlock(&caller->mm->mm_lock);
+    return -1;
+  }
 
   /* FIX: Dùng caller->mm */
-  pg_getval(caller->mm, currg->rg_start + offset, data, caller);
-  return 0;
+  ret = pg_getval(caller->mm, currg->rg_start + offset, data, caller);
+
+  pthread_mutex_unlock(&caller->mm->mm_lock);
+  return ret;
 }
 
 /* libread - PAGING-based read a region memory */
@@ -257,6 +881,7 @@ int libread(struct pcb_t *proc, uint32_t source, addr_t offset, uint32_t* destin
 {
   BYTE data;
   int val = __read(proc, 0, source, offset, &data);
+  if (val == -1) return -1;
 
   *destination = data;
 
@@ -275,21 +900,22 @@ int libread(struct pcb_t *proc, uint32_t source, addr_t offset, uint32_t* destin
 /* __write - write a region memory */
 int __write(struct pcb_t *caller, int vmaid, int rgid, addr_t offset, BYTE value)
 {
-  pthread_mutex_lock(&mmvm_lock);
+  pthread_mutex_lock(&caller->mm->mm_lock);
   /* FIX: Dùng caller->mm */
   struct vm_rg_struct *currg = get_symrg_byid(caller->mm, rgid);
   struct vm_area_struct *cur_vma = get_vma_by_num(caller->mm, vmaid);
+  int ret;
 
   if (currg == NULL || cur_vma == NULL) {
-    pthread_mutex_unlock(&mmvm_lock);
+    pthread_mutex_unlock(&caller->mm->mm_lock);
     return -1;
   }
 
   /* FIX: Dùng caller->mm */
-  pg_setval(caller->mm, currg->rg_start + offset, value, caller);
+  ret = pg_setval(caller->mm, currg->rg_start + offset, value, caller);
 
-  pthread_mutex_unlock(&mmvm_lock);
-  return 0;
+  pthread_mutex_unlock(&caller->mm->mm_lock);
+  return ret;
 }
 
 /* libwrite - PAGING-based write a region memory */
@@ -313,31 +939,20 @@ int libwrite(struct pcb_t *proc, BYTE data, uint32_t destination, addr_t offset)
 /* free_pcb_memphy - collect all memphy of pcb */
 int free_pcb_memph(struct pcb_t *caller)
 {
-  pthread_mutex_lock(&mmvm_lock);
-  /* Phần này thường không dùng trong bài tập cơ bản, để trống hoặc implement nếu cần */
-  pthread_mutex_unlock(&mmvm_lock);
-  return 0;
-}
+  if (caller->mm == NULL)
+    return -1;
 
-/* find_victim_page - find victim page */
-int find_victim_page(struct mm_struct *mm, addr_t *retpgn)
-{
-  struct pgn_t *pg = mm->fifo_pgn;
-  if (!pg) return -1;
+  kswapd_unregister(caller);
 
-  /* FIFO Algorithm: Lấy phần tử cuối cùng trong danh sách */
-  struct pgn_t *prev = NULL;
-  while (pg->pg_next) {
-    prev = pg;
-    pg = pg->pg_next;
-  }
-  
-  *retpgn = pg->pgn;
-  
-  if (prev) prev->pg_next = NULL;
-  else mm->fifo_pgn = NULL; 
+  /* Wait for anyone still working on this space, then take it down */
+  pthread_mutex_lock(&caller->mm->mm_lock);
+  pthread_mutex_unlock(&caller->mm->mm_lock);
+
+  if (caller->krnl->mm == caller->mm)
+    caller->krnl->mm = NULL;
+
+  free_mm(caller);
 
-  free(pg);
   return 0;
 }
 
@@ -346,39 +961,8 @@ int get_free_vmrg_area(struct pcb_t *caller, int vmaid, int size, struct vm_rg_s
 {
   /* FIX: Dùng caller->mm */
   struct vm_area_struct *cur_vma = get_vma_by_num(caller->mm, vmaid);
-  struct vm_rg_struct *rgit = cur_vma->vm_freerg_list;
 
-  if (rgit == NULL) return -1;
-
-  newrg->rg_start = newrg->rg_end = -1;
-
-  while (rgit != NULL)
-  {
-    if (rgit->rg_start + size <= rgit->rg_end)
-    { 
-      newrg->rg_start = rgit->rg_start;
-      newrg->rg_end = rgit->rg_start + size;
+  if (cur_vma == NULL) return -1;
 
-      if (rgit->rg_start + size < rgit->rg_end) {
-        rgit->rg_start = rgit->rg_start + size;
-      }
-      else { 
-        struct vm_rg_struct *nextrg = rgit->rg_next;
-        if (nextrg != NULL) {
-          rgit->rg_start = nextrg->rg_start;
-          rgit->rg_end = nextrg->rg_end;
-          rgit->rg_next = nextrg->rg_next;
-          free(nextrg);
-        }
-        else {                                
-          rgit->rg_start = rgit->rg_end; 
-          rgit->rg_next = NULL;
-        }
-      }
-      return 0;
-    }
-    rgit = rgit->rg_next;
-  }
-
-  return -1;
-}
\ No newline at end of file
+  return vm_freerg_get(cur_vma, size, newrg);
+}
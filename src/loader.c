@@ -3,8 +3,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 
 static uint32_t avail_pid = 1;
+static pthread_mutex_t pid_lock = PTHREAD_MUTEX_INITIALIZER;
 
 #define OPT_CALC	"calc"
 #define OPT_ALLOC	"alloc"
@@ -32,11 +34,41 @@ static enum ins_opcode_t get_opcode(char * opt) {
 	}
 }
 
+/* Processes are also created by fork at run time, hand out PIDs safely */
+uint32_t alloc_pid(void) {
+	uint32_t pid;
+
+	pthread_mutex_lock(&pid_lock);
+	pid = avail_pid;
+	avail_pid++;
+	pthread_mutex_unlock(&pid_lock);
+
+	return pid;
+}
+
+/* Create a copy of a running process, the address space is left to the caller */
+struct pcb_t * clone_proc(struct pcb_t * parent) {
+	struct pcb_t * proc = (struct pcb_t * )malloc(sizeof(struct pcb_t));
+
+	memcpy(proc, parent, sizeof(struct pcb_t));
+	proc->pid = alloc_pid();
+
+	/* Own copy of the code segment, both continue after the fork point */
+	proc->code = (struct code_seg_t*)malloc(sizeof(struct code_seg_t));
+	proc->code->size = parent->code->size;
+	proc->code->text = (struct inst_t*)malloc(
+		sizeof(struct inst_t) * parent->code->size
+	);
+	memcpy(proc->code->text, parent->code->text,
+		sizeof(struct inst_t) * parent->code->size);
+
+	return proc;
+}
+
 struct pcb_t * load(const char * path) {
 	/* Create new PCB for the new process */
 	struct pcb_t * proc = (struct pcb_t * )malloc(sizeof(struct pcb_t));
-	proc->pid = avail_pid;
-	avail_pid++;
+	proc->pid = alloc_pid();
 	#ifndef MM_PAGING
     proc->page_table =
         (struct page_table_t*)malloc(sizeof(struct page_table_t));
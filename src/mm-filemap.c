@@ -0,0 +1,280 @@
+/*
+ * Copyright (C) 2026 pdnguyen of HCMC University of Technology VNU-HCM
+ */
+
+/* LamiaAtrium release
+ * Source Code License Grant: The authors hereby grant to Licensee
+ * personal permission to use and modify the Licensed Source Code
+ * for the sole purpose of studying while attending the course CO2018.
+ */
+
+//#ifdef MM_PAGING
+/*
+ * PAGING based Memory Management
+ * Page cache of mapped host files mm/mm-filemap.c
+ *
+ * Every host file mapped by some process has one set of cached pages,
+ * shared by all of its mappings.  The cache holds a reference on each
+ * cached frame, page tables mapping it hold one more.  Mappings are
+ * private: a write gets the writer its own copy, the file never
+ * changes.  Pages nobody maps any more are reclaimed before any process
+ * page has to go out to swap.
+ */
+
+#include "mm.h"
+#include "mm64.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <pthread.h>
+
+struct pgcache_file {
+   char *path;
+   int fd;
+   addr_t size;
+   addr_t npages;
+   addr_t *fpn;      /* cached frame, PAGING_FPN_INVALID if none */
+   BYTE *ra;         /* read ahead and not used yet */
+   addr_t ra_next;   /* first page past the last read-ahead window */
+   struct pgcache_file *next;
+};
+
+static struct pgcache_file *pgcache_files;
+static pthread_mutex_t pgcache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Reclaim hand, walks the cached pages round robin */
+static struct pgcache_file *pgcache_hand;
+static addr_t pgcache_hand_idx;
+
+static struct {
+   unsigned long files;
+   unsigned long hits;
+   unsigned long misses;
+   unsigned long readahead;
+   unsigned long ra_hits;
+   unsigned long reclaimed;
+} pgcache_stat;
+
+/* __file_read - load a page of a file into a frame, zeros past the end */
+static void __file_read(struct memphy_struct *mram, struct pgcache_file *f,
+                        addr_t idx, addr_t fpn)
+{
+   BYTE buf[PAGING64_PAGESZ];
+   ssize_t n;
+
+   n = pread(f->fd, buf, PAGING64_PAGESZ, idx * PAGING64_PAGESZ);
+   if (n < 0)
+      n = 0;
+   memset(buf + n, 0, PAGING64_PAGESZ - n);
+
+   MEMPHY_write_page(mram, fpn, buf);
+}
+
+/*
+ * __readahead - cache the pages of [from, from + PGCACHE_RA_PAGES)
+ * Only free frames are used, reading ahead never evicts.
+ */
+static void __readahead(struct memphy_struct *mram, struct pgcache_file *f, addr_t from)
+{
+   addr_t idx, fpn;
+
+   for (idx = from; idx < from + PGCACHE_RA_PAGES && idx < f->npages; idx++)
+   {
+      if (f->fpn[idx] != PAGING_FPN_INVALID)
+         continue;
+      if (MEMPHY_get_freefp(mram, &fpn) != 0)
+         break;
+
+      __file_read(mram, f, idx, fpn);
+      f->fpn[idx] = fpn;
+      f->ra[idx] = 1;
+      pgcache_stat.readahead++;
+   }
+
+   f->ra_next = idx;
+}
+
+static struct pgcache_file *__file_open(const char *path)
+{
+   struct pgcache_file *f;
+   struct stat st;
+   addr_t i;
+   int fd;
+
+   for (f = pgcache_files; f != NULL; f = f->next)
+      if (strcmp(f->path, path) == 0)
+         return f;
+
+   fd = open(path, O_RDONLY);
+   if (fd < 0)
+      return NULL;
+   if (fstat(fd, &st) != 0 || st.st_size == 0)
+   {
+      close(fd);
+      return NULL;
+   }
+
+   f = malloc(sizeof(struct pgcache_file));
+   f->path = strdup(path);
+   f->fd = fd;
+   f->size = st.st_size;
+   f->npages = DIV_ROUND_UP(f->size, PAGING64_PAGESZ);
+   f->fpn = malloc(f->npages * sizeof(addr_t));
+   f->ra = calloc(f->npages, sizeof(BYTE));
+   f->ra_next = 0;
+   for (i = 0; i < f->npages; i++)
+      f->fpn[i] = PAGING_FPN_INVALID;
+
+   f->next = pgcache_files;
+   pgcache_files = f;
+   pgcache_stat.files++;
+
+   return f;
+}
+
+/*
+ * filemap_mmap - map a host file into a new area of the caller
+ * @rgid: region handle bound to the file contents
+ * @addr: start of the area
+ * The caller holds its mm lock.
+ */
+int filemap_mmap(struct pcb_t *caller, const char *path, int rgid, addr_t *addr)
+{
+   struct mm_struct *mm = caller->mm;
+   struct pgcache_file *f;
+   struct vm_area_struct *vma;
+   addr_t len;
+
+   pthread_mutex_lock(&pgcache_lock);
+   f = __file_open(path);
+   pthread_mutex_unlock(&pgcache_lock);
+   if (f == NULL)
+      return -1;
+
+   len = f->npages * PAGING64_PAGESZ;
+   if (len > mm->mmap_base)
+      return -1;
+
+   /* Pages come from the cache on touch */
+   vma = vm_area_create(mm, mm->mmap_base - len, mm->mmap_base, VM_SHARED);
+   if (vma == NULL)
+      return -1;
+   vma->vm_file = f;
+
+   if (symrg_bind(mm, rgid, vma->vm_start, vma->vm_start + f->size) != 0)
+   {
+      vm_area_unlink(mm, vma);
+      return -1;
+   }
+
+   mm->mmap_base = vma->vm_start;
+   *addr = vma->vm_start;
+   return 0;
+}
+
+/*
+ * filemap_getpage - cached frame of a file page for a faulting space
+ * @newfpn: free frame taken beforehand for a miss
+ * @fpn   : the frame to map, it comes with a reference for the mapping
+ * A miss reads the next pages ahead, so does the first use of a page
+ * read ahead once the window runs short.
+ * Returns 0 on a hit, 1 if newfpn got used for a miss.
+ */
+int filemap_getpage(struct memphy_struct *mram, struct pgcache_file *f, addr_t idx,
+                    addr_t newfpn, addr_t *fpn)
+{
+   int ret = 0;
+
+   if (idx >= f->npages)
+      return -1;
+
+   pthread_mutex_lock(&pgcache_lock);
+
+   if (f->fpn[idx] != PAGING_FPN_INVALID)
+   {
+      pgcache_stat.hits++;
+      if (f->ra[idx])
+      {
+         f->ra[idx] = 0;
+         pgcache_stat.ra_hits++;
+         if (idx + PGCACHE_RA_PAGES / 2 >= f->ra_next)
+            __readahead(mram, f, f->ra_next);
+      }
+   }
+   else
+   {
+      pgcache_stat.misses++;
+      __file_read(mram, f, idx, newfpn);
+      f->fpn[idx] = newfpn;
+      __readahead(mram, f, idx + 1);
+      ret = 1;
+   }
+
+   MEMPHY_ref_fp(mram, f->fpn[idx]);
+   *fpn = f->fpn[idx];
+   pthread_mutex_unlock(&pgcache_lock);
+
+   return ret;
+}
+
+/*
+ * pgcache_shrink - free one cached page no space maps
+ * Returns 0 if a frame went back to RAM, -1 if none could.
+ */
+int pgcache_shrink(struct memphy_struct *mram)
+{
+   struct pgcache_file *f;
+   addr_t scanned = 0, total = 0;
+   addr_t fpn;
+
+   pthread_mutex_lock(&pgcache_lock);
+   for (f = pgcache_files; f != NULL; f = f->next)
+      total += f->npages;
+
+   while (scanned++ < total)
+   {
+      if (pgcache_hand == NULL || pgcache_hand_idx >= pgcache_hand->npages)
+      {
+         pgcache_hand = (pgcache_hand != NULL && pgcache_hand->next != NULL) ?
+                        pgcache_hand->next : pgcache_files;
+         pgcache_hand_idx = 0;
+      }
+
+      fpn = pgcache_hand->fpn[pgcache_hand_idx];
+      if (fpn != PAGING_FPN_INVALID && MEMPHY_refcnt_fp(mram, fpn) == 1)
+      {
+         pgcache_hand->fpn[pgcache_hand_idx] = PAGING_FPN_INVALID;
+         pgcache_hand->ra[pgcache_hand_idx] = 0;
+         pgcache_hand_idx++;
+         MEMPHY_put_freefp(mram, fpn);
+         pgcache_stat.reclaimed++;
+         pthread_mutex_unlock(&pgcache_lock);
+         return 0;
+      }
+      pgcache_hand_idx++;
+   }
+   pthread_mutex_unlock(&pgcache_lock);
+
+   return -1;
+}
+
+void pgcache_report(void)
+{
+   unsigned long lookups;
+
+   pthread_mutex_lock(&pgcache_lock);
+   lookups = pgcache_stat.hits + pgcache_stat.misses;
+   if (pgcache_stat.files > 0)
+      printf("Page cache: files %lu hits %lu misses %lu hit ratio %.4f "
+             "read ahead %lu (used %lu) reclaimed %lu\n",
+             pgcache_stat.files, pgcache_stat.hits, pgcache_stat.misses,
+             lookups ? (double)pgcache_stat.hits / lookups : 0.0,
+             pgcache_stat.readahead, pgcache_stat.ra_hits,
+             pgcache_stat.reclaimed);
+   pthread_mutex_unlock(&pgcache_lock);
+}
+
+//#endif
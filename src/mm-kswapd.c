@@ -0,0 +1,230 @@
+/*
+ * Copyright (C) 2026 pdnguyen of HCMC University of Technology VNU-HCM
+ */
+
+/* LamiaAtrium release
+ * Source Code License Grant: The authors hereby grant to Licensee
+ * personal permission to use and modify the Licensed Source Code
+ * for the sole purpose of studying while attending the course CO2018.
+ */
+
+//#ifdef MM_PAGING
+/*
+ * PAGING based Memory Management
+ * Background page reclaim daemon mm/mm-kswapd.c
+ *
+ * The daemon sleeps until the free RAM frames fall below the low
+ * watermark, then pushes pages of the registered processes out to swap
+ * until the high watermark is back.  Faults still evict inline when
+ * they outrun it.
+ */
+
+#include "mm.h"
+#include "mm64.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+
+struct kswapd_node {
+   struct pcb_t *proc;
+   struct kswapd_node *next;
+};
+
+/* Processes whose pages may be reclaimed, walked round robin */
+static struct kswapd_node *kswapd_procs;
+static struct kswapd_node *kswapd_hand;
+static pthread_mutex_t kswapd_reg_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_t kswapd_thread;
+static pthread_mutex_t kswapd_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t kswapd_cond = PTHREAD_COND_INITIALIZER;
+static int kswapd_running;
+static int kswapd_pending;
+static int kswapd_stopping;
+
+static struct memphy_struct *kswapd_mram;
+static int kswapd_low_wmark;
+static int kswapd_high_wmark;
+
+/*
+ * kswapd_register - make the pages of a process reclaimable
+ * @proc: process owning a fully set up mm
+ */
+int kswapd_register(struct pcb_t *proc)
+{
+   struct kswapd_node *node = malloc(sizeof(struct kswapd_node));
+
+   node->proc = proc;
+
+   pthread_mutex_lock(&kswapd_reg_lock);
+   node->next = kswapd_procs;
+   kswapd_procs = node;
+   pthread_mutex_unlock(&kswapd_reg_lock);
+
+   return 0;
+}
+
+/*
+ * kswapd_unregister - forget a process before its mm goes away
+ * Waits for a reclaim pass working on it, the daemon holds the
+ * registry lock while it evicts.
+ */
+int kswapd_unregister(struct pcb_t *proc)
+{
+   struct kswapd_node **pnode, *node;
+
+   pthread_mutex_lock(&kswapd_reg_lock);
+   for (pnode = &kswapd_procs; *pnode != NULL; pnode = &(*pnode)->next)
+   {
+      node = *pnode;
+      if (node->proc != proc)
+         continue;
+
+      *pnode = node->next;
+      if (kswapd_hand == node)
+         kswapd_hand = node->next;
+      free(node);
+      break;
+   }
+   pthread_mutex_unlock(&kswapd_reg_lock);
+
+   return 0;
+}
+
+/*
+ * kswapd_wakeup - kick the daemon when RAM runs low
+ * Cheap enough to call after every frame allocation.
+ */
+void kswapd_wakeup(struct memphy_struct *mram)
+{
+   if (!kswapd_running || mram != kswapd_mram ||
+       mram->free_fp_cnt >= kswapd_low_wmark)
+      return;
+
+   pthread_mutex_lock(&kswapd_lock);
+   kswapd_pending = 1;
+   pthread_cond_signal(&kswapd_cond);
+   pthread_mutex_unlock(&kswapd_lock);
+}
+
+/*
+ * __kswapd_balance - evict until the high watermark is reached
+ * Cached file pages nobody maps go before any process page.
+ * Gives up after a full round without any page leaving RAM, or once
+ * as many pages as RAM holds were pushed out (shared frames do not
+ * come back free).
+ */
+static void __kswapd_balance(void)
+{
+   struct pcb_t *proc;
+   int budget = kswapd_mram->maxsz / PAGING64_PAGESZ;
+   int idle = 0;
+   int nprocs;
+   struct kswapd_node *node;
+
+   /* Unmapped file pages are the cheapest to drop */
+   while (kswapd_mram->free_fp_cnt < kswapd_high_wmark &&
+          pgcache_shrink(kswapd_mram) == 0)
+      ;
+
+   pthread_mutex_lock(&kswapd_reg_lock);
+
+   for (nprocs = 0, node = kswapd_procs; node != NULL; node = node->next)
+      nprocs++;
+
+   while (nprocs > 0 && idle < nprocs && budget > 0 &&
+          kswapd_mram->free_fp_cnt < kswapd_high_wmark)
+   {
+      if (kswapd_hand == NULL)
+         kswapd_hand = kswapd_procs;
+      proc = kswapd_hand->proc;
+      kswapd_hand = kswapd_hand->next;
+
+      pthread_mutex_lock(&proc->mm->mm_lock);
+      if (pg_evict(proc) == 0)
+      {
+         idle = 0;
+         budget--;
+      }
+      else
+         idle++;
+      pthread_mutex_unlock(&proc->mm->mm_lock);
+   }
+
+   pthread_mutex_unlock(&kswapd_reg_lock);
+}
+
+static void *kswapd_routine(void *args)
+{
+   while (1)
+   {
+      pthread_mutex_lock(&kswapd_lock);
+      while (!kswapd_pending && !kswapd_stopping)
+         pthread_cond_wait(&kswapd_cond, &kswapd_lock);
+      kswapd_pending = 0;
+      if (kswapd_stopping)
+      {
+         pthread_mutex_unlock(&kswapd_lock);
+         break;
+      }
+      pthread_mutex_unlock(&kswapd_lock);
+
+#ifdef MMDBG
+      printf("kswapd: free frames %d below %d\n",
+             kswapd_mram->free_fp_cnt, kswapd_low_wmark);
+#endif
+      __kswapd_balance();
+   }
+
+   pthread_exit(NULL);
+}
+
+/*
+ * kswapd_start - set the watermarks of the RAM device and run the daemon
+ * @mram: RAM device to keep frames free on
+ */
+int kswapd_start(struct memphy_struct *mram)
+{
+   int numfp = mram->maxsz / PAGING64_PAGESZ;
+
+   kswapd_mram = mram;
+   kswapd_low_wmark = numfp * KSWAPD_LOW_WMARK_PCT / 100;
+   kswapd_high_wmark = numfp * KSWAPD_HIGH_WMARK_PCT / 100;
+
+   /* Small RAMs still keep a frame at hand */
+   if (kswapd_low_wmark < 1)
+      kswapd_low_wmark = 1;
+   if (kswapd_high_wmark <= kswapd_low_wmark)
+      kswapd_high_wmark = kswapd_low_wmark + 1;
+   if (kswapd_high_wmark >= numfp)
+      return -1;
+
+   kswapd_stopping = 0;
+   kswapd_pending = 0;
+   if (pthread_create(&kswapd_thread, NULL, kswapd_routine, NULL) != 0)
+      return -1;
+   kswapd_running = 1;
+
+   return 0;
+}
+
+/*
+ * kswapd_stop - stop the daemon and wait for it
+ */
+int kswapd_stop(void)
+{
+   if (!kswapd_running)
+      return -1;
+
+   pthread_mutex_lock(&kswapd_lock);
+   kswapd_stopping = 1;
+   pthread_cond_signal(&kswapd_cond);
+   pthread_mutex_unlock(&kswapd_lock);
+
+   pthread_join(kswapd_thread, NULL);
+   kswapd_running = 0;
+
+   return 0;
+}
+
+//#endif
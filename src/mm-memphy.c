@@ -18,26 +18,146 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <inttypes.h>
 #include "mm64.h"
 
+/* Frame size of the devices follows the paging mode */
+#ifdef MM64
+#define MEMPHY_PAGESZ PAGING64_PAGESZ
+#else
+#define MEMPHY_PAGESZ PAGING_PAGESZ
+#endif
+
 /*
  * MEMPHY_mv_csr - move MEMPHY cursor
  * @mp: memphy struct
  * @offset: offset
+ * The device clock pays the seek cost for every frame travelled.
  */
 int MEMPHY_mv_csr(struct memphy_struct *mp, addr_t offset)
 {
-   int numstep = 0;
+   addr_t from = mp->cursor / MEMPHY_PAGESZ;
+   addr_t to = offset / MEMPHY_PAGESZ;
+   addr_t dist = (to > from) ? to - from : from - to;
 
-   mp->cursor = 0;
-   while (numstep < offset && numstep < mp->maxsz)
+   mp->cursor = offset % mp->maxsz;
+   mp->io_clock += dist * mp->seek_cost;
+   mp->iostat.seek_frames += dist;
+
+   return 0;
+}
+
+/* __csr_past - leave the cursor past a frame just streamed, at the end
+ * of the device it stays on the last frame */
+static void __csr_past(struct memphy_struct *mp, addr_t addr)
+{
+   if (addr + MEMPHY_PAGESZ < mp->maxsz)
+      mp->cursor = addr + MEMPHY_PAGESZ;
+   else
+      mp->cursor = addr;
+}
+
+/*
+ * __ioq_serve - carry out a queued transfer and drop it from the queue
+ * The cursor streams over the frame and stops past it.
+ */
+static void __ioq_serve(struct memphy_struct *mp, int i)
+{
+   struct memphy_ioreq *rq = &mp->ioq[i];
+   struct memphy_ioreq tmp;
+   addr_t addr = rq->fpn * MEMPHY_PAGESZ;
+
+   MEMPHY_mv_csr(mp, addr);
+   if (rq->wr)
+      memcpy(mp->storage + addr, rq->buf, MEMPHY_PAGESZ);
+   else
+      memcpy(rq->peer->storage + rq->peerfpn * MEMPHY_PAGESZ,
+             mp->storage + addr, MEMPHY_PAGESZ);
+   __csr_past(mp, addr);
+   mp->io_clock += mp->xfer_cost;
+
+   if (rq->wr)
    {
-      /* Traverse sequentially */
-      mp->cursor = (mp->cursor + 1) % mp->maxsz;
-      numstep++;
+      mp->iostat.writes++;
+      mp->iostat.wr_latency += mp->io_clock - rq->arrival;
+   }
+   else
+   {
+      mp->iostat.reads++;
+      mp->iostat.rd_latency += mp->io_clock - rq->arrival;
    }
 
-   return 0;
+   /* The last request fills the hole, buffers move along with them */
+   tmp = *rq;
+   *rq = mp->ioq[--mp->ioq_cnt];
+   mp->ioq[mp->ioq_cnt] = tmp;
+}
+
+/*
+ * __ioq_ahead - nearest queued request from the cursor on in a direction
+ * Returns its index, -1 if there is none that way.
+ */
+static int __ioq_ahead(struct memphy_struct *mp, int dir)
+{
+   addr_t head = mp->cursor / MEMPHY_PAGESZ;
+   int i, best = -1;
+
+   for (i = 0; i < mp->ioq_cnt; i++)
+   {
+      if ((dir > 0) ? (mp->ioq[i].fpn < head) : (mp->ioq[i].fpn > head))
+         continue;
+      if (best < 0 || ((dir > 0) ? (mp->ioq[i].fpn < mp->ioq[best].fpn)
+                                 : (mp->ioq[i].fpn > mp->ioq[best].fpn)))
+         best = i;
+   }
+
+   return best;
+}
+
+/*
+ * __ioq_pick - next request to serve
+ * FIFO goes by queueing order.  SCAN sweeps on to the edge of the
+ * device before it turns around, C-LOOK only sweeps up and jumps back
+ * to the lowest request.
+ */
+static int __ioq_pick(struct memphy_struct *mp)
+{
+   int i, best;
+
+   if (mp->iosched == MEMPHY_IOSCHED_FIFO)
+   {
+      for (best = 0, i = 1; i < mp->ioq_cnt; i++)
+         if (mp->ioq[i].seq < mp->ioq[best].seq)
+            best = i;
+      return best;
+   }
+
+   best = __ioq_ahead(mp, mp->io_dir);
+   if (best >= 0)
+      return best;
+
+   if (mp->iosched == MEMPHY_IOSCHED_SCAN)
+   {
+      MEMPHY_mv_csr(mp, (mp->io_dir > 0) ? mp->maxsz - MEMPHY_PAGESZ : 0);
+      mp->io_dir = -mp->io_dir;
+      return __ioq_ahead(mp, mp->io_dir);
+   }
+
+   for (best = 0, i = 1; i < mp->ioq_cnt; i++)
+      if (mp->ioq[i].fpn < mp->ioq[best].fpn)
+         best = i;
+   return best;
+}
+
+/* __ioq_run - serve every queued request, under the device lock */
+static void __ioq_run(struct memphy_struct *mp)
+{
+   while (mp->ioq_cnt > 0)
+      __ioq_serve(mp, __ioq_pick(mp));
 }
 
 /*
@@ -51,11 +171,15 @@ int MEMPHY_seq_read(struct memphy_struct *mp, addr_t addr, BYTE *value)
    if (mp == NULL)
       return -1;
 
-   if (!mp->rdmflg)
+   if (mp->rdmflg)
       return -1; /* Not compatible mode for sequential read */
 
+   /* The cursor is shared by every user of the device */
+   pthread_mutex_lock(&mp->fp_lock);
+   __ioq_run(mp);
    MEMPHY_mv_csr(mp, addr);
    *value = (BYTE)mp->storage[addr];
+   pthread_mutex_unlock(&mp->fp_lock);
 
    return 0;
 }
@@ -68,7 +192,7 @@ int MEMPHY_seq_read(struct memphy_struct *mp, addr_t addr, BYTE *value)
  */
 int MEMPHY_read(struct memphy_struct *mp, addr_t addr, BYTE *value)
 {
-   if (mp == NULL)
+   if (mp == NULL || addr >= mp->maxsz)
       return -1;
 
    if (mp->rdmflg)
@@ -91,11 +215,14 @@ int MEMPHY_seq_write(struct memphy_struct *mp, addr_t addr, BYTE value)
    if (mp == NULL)
       return -1;
 
-   if (!mp->rdmflg)
-      return -1; /* Not compatible mode for sequential read */
+   if (mp->rdmflg)
+      return -1; /* Not compatible mode for sequential write */
 
+   pthread_mutex_lock(&mp->fp_lock);
+   __ioq_run(mp);
    MEMPHY_mv_csr(mp, addr);
    mp->storage[addr] = value;
+   pthread_mutex_unlock(&mp->fp_lock);
 
    return 0;
 }
@@ -108,7 +235,7 @@ int MEMPHY_seq_write(struct memphy_struct *mp, addr_t addr, BYTE value)
  */
 int MEMPHY_write(struct memphy_struct *mp, addr_t addr, BYTE data)
 {
-   if (mp == NULL)
+   if (mp == NULL || addr >= mp->maxsz)
       return -1;
 
    if (mp->rdmflg)
@@ -119,6 +246,366 @@ int MEMPHY_write(struct memphy_struct *mp, addr_t addr, BYTE data)
    return 0;
 }
 
+/*
+ * MEMPHY_read_page - read a whole frame of MEMPHY device
+ * @mp: memphy struct
+ * @fpn: frame number
+ * @buf: receives the frame contents
+ * A sequential device seeks once to the frame, then streams it.
+ */
+int MEMPHY_read_page(struct memphy_struct *mp, addr_t fpn, BYTE *buf)
+{
+   addr_t addr = fpn * MEMPHY_PAGESZ;
+   unsigned long start;
+
+   if (mp == NULL || addr + MEMPHY_PAGESZ > mp->maxsz)
+      return -1;
+
+   if (mp->rdmflg)
+   {
+      memcpy(buf, mp->storage + addr, MEMPHY_PAGESZ);
+      return 0;
+   }
+
+   /* Served after whatever is queued, as the only request */
+   pthread_mutex_lock(&mp->fp_lock);
+   __ioq_run(mp);
+   start = mp->io_clock;
+   MEMPHY_mv_csr(mp, addr);
+   memcpy(buf, mp->storage + addr, MEMPHY_PAGESZ);
+   __csr_past(mp, addr);
+   mp->io_clock += mp->xfer_cost;
+   mp->iostat.reads++;
+   mp->iostat.rd_latency += mp->io_clock - start;
+   pthread_mutex_unlock(&mp->fp_lock);
+
+   return 0;
+}
+
+/*
+ * MEMPHY_write_page - write a whole frame of MEMPHY device
+ * @mp: memphy struct
+ * @fpn: frame number
+ * @buf: new frame contents
+ */
+int MEMPHY_write_page(struct memphy_struct *mp, addr_t fpn, const BYTE *buf)
+{
+   addr_t addr = fpn * MEMPHY_PAGESZ;
+   unsigned long start;
+
+   if (mp == NULL || addr + MEMPHY_PAGESZ > mp->maxsz)
+      return -1;
+
+   if (mp->rdmflg)
+   {
+      memcpy(mp->storage + addr, buf, MEMPHY_PAGESZ);
+      return 0;
+   }
+
+   pthread_mutex_lock(&mp->fp_lock);
+   __ioq_run(mp);
+   start = mp->io_clock;
+   MEMPHY_mv_csr(mp, addr);
+   memcpy(mp->storage + addr, buf, MEMPHY_PAGESZ);
+   __csr_past(mp, addr);
+   mp->io_clock += mp->xfer_cost;
+   mp->iostat.writes++;
+   mp->iostat.wr_latency += mp->io_clock - start;
+   pthread_mutex_unlock(&mp->fp_lock);
+
+   return 0;
+}
+
+/*
+ * MEMPHY_copy_page - copy a frame from one device to another
+ * Random access devices copy in place, anything else goes through a
+ * page buffer.
+ */
+int MEMPHY_copy_page(struct memphy_struct *mpsrc, addr_t srcfpn,
+                     struct memphy_struct *mpdst, addr_t dstfpn)
+{
+   BYTE buf[MEMPHY_PAGESZ];
+
+   if (mpsrc == NULL || mpdst == NULL ||
+       (srcfpn + 1) * MEMPHY_PAGESZ > mpsrc->maxsz ||
+       (dstfpn + 1) * MEMPHY_PAGESZ > mpdst->maxsz)
+      return -1;
+
+   if (mpsrc->rdmflg && mpdst->rdmflg)
+   {
+      memmove(mpdst->storage + dstfpn * MEMPHY_PAGESZ,
+              mpsrc->storage + srcfpn * MEMPHY_PAGESZ, MEMPHY_PAGESZ);
+      return 0;
+   }
+
+   if (MEMPHY_read_page(mpsrc, srcfpn, buf) != 0)
+      return -1;
+   return MEMPHY_write_page(mpdst, dstfpn, buf);
+}
+
+/*
+ * MEMPHY_submit - queue a page transfer on a device
+ * @mp     : device
+ * @fpn    : frame on the device
+ * @peer   : random access device at the other end, RAM
+ * @peerfpn: its frame, copied at once for a write, filled for a read
+ *           once the request is served
+ * @wr     : write to the device
+ * Random access devices transfer at once, sequential ones keep the
+ * request queued until MEMPHY_unplug or a full queue.
+ */
+int MEMPHY_submit(struct memphy_struct *mp, addr_t fpn,
+                  struct memphy_struct *peer, addr_t peerfpn, int wr)
+{
+   struct memphy_ioreq *rq;
+
+   if (mp == NULL || peer == NULL || !peer->rdmflg ||
+       (fpn + 1) * MEMPHY_PAGESZ > mp->maxsz ||
+       (peerfpn + 1) * MEMPHY_PAGESZ > peer->maxsz)
+      return -1;
+
+   if (mp->rdmflg)
+      return wr ? MEMPHY_copy_page(peer, peerfpn, mp, fpn)
+                : MEMPHY_copy_page(mp, fpn, peer, peerfpn);
+
+   pthread_mutex_lock(&mp->fp_lock);
+   if (mp->ioq_cnt == MEMPHY_IOQ_MAX)
+      __ioq_run(mp);
+
+   rq = &mp->ioq[mp->ioq_cnt++];
+   rq->fpn = fpn;
+   rq->wr = wr;
+   rq->peer = peer;
+   rq->peerfpn = peerfpn;
+   rq->arrival = mp->io_clock;
+   rq->seq = mp->ioq_seq++;
+   if (wr)
+      memcpy(rq->buf, peer->storage + peerfpn * MEMPHY_PAGESZ, MEMPHY_PAGESZ);
+   pthread_mutex_unlock(&mp->fp_lock);
+
+   return 0;
+}
+
+/*
+ * MEMPHY_unplug - serve the queued requests of a device
+ */
+void MEMPHY_unplug(struct memphy_struct *mp)
+{
+   if (mp == NULL || mp->rdmflg)
+      return;
+
+   pthread_mutex_lock(&mp->fp_lock);
+   __ioq_run(mp);
+   pthread_mutex_unlock(&mp->fp_lock);
+}
+
+/*
+ * MEMPHY_set_iosched - order and cost of sequential device requests
+ * @name: "fifo" (default when NULL), "scan" or "clook"
+ * @seek: slots per frame the cursor travels
+ * @xfer: slots per frame transferred
+ */
+int MEMPHY_set_iosched(struct memphy_struct *mp, const char *name,
+                       unsigned long seek, unsigned long xfer)
+{
+   int sched;
+
+   if (name == NULL || strcmp(name, "fifo") == 0)
+      sched = MEMPHY_IOSCHED_FIFO;
+   else if (strcmp(name, "scan") == 0)
+      sched = MEMPHY_IOSCHED_SCAN;
+   else if (strcmp(name, "clook") == 0)
+      sched = MEMPHY_IOSCHED_CLOOK;
+   else
+      return -1;
+
+   MEMPHY_unplug(mp);
+   mp->iosched = sched;
+   mp->seek_cost = seek;
+   mp->xfer_cost = xfer;
+
+   return 0;
+}
+
+/*
+ * MEMPHY_ioreport - print the cost counters of a sequential device
+ * @label: name of the device in the report
+ */
+void MEMPHY_ioreport(struct memphy_struct *mp, const char *label)
+{
+   static const char *sched[] = { "fifo", "scan", "clook" };
+   struct memphy_iostat *st = &mp->iostat;
+
+   pthread_mutex_lock(&mp->fp_lock);
+   printf("%s %s: reads %lu writes %lu seek %lu frames busy %lu slots "
+          "latency read %.2f write %.2f\n",
+          label, sched[mp->iosched], st->reads, st->writes, st->seek_frames,
+          mp->io_clock,
+          st->reads ? (double)st->rd_latency / st->reads : 0.0,
+          st->writes ? (double)st->wr_latency / st->writes : 0.0);
+   pthread_mutex_unlock(&mp->fp_lock);
+}
+
+/*
+ * Buddy allocator: free frames are kept as aligned blocks of 2^order
+ * frames, one list per order linked through the first frame of a block.
+ * Blocks split on the way out and merge with their free buddy on the
+ * way back.  Whole blocks of the largest order from fp_fresh on were
+ * never handed out and are not listed yet.
+ */
+#define MEMPHY_BLKSZ(order) ((addr_t)1 << (order))
+
+/* Frame metadata of one largest block */
+#define MEMPHY_META_FRAMES MEMPHY_BLKSZ(MEMPHY_MAX_ORDER)
+#define MEMPHY_META_IDX(fpn) ((fpn) & (MEMPHY_META_FRAMES - 1))
+
+struct memphy_fpmeta {
+   addr_t next[MEMPHY_META_FRAMES]; /* list links, at the first frame of */
+   addr_t prev[MEMPHY_META_FRAMES]; /* a free block */
+   BYTE order[MEMPHY_META_FRAMES];  /* order + 1 of a free block head */
+   uint32_t refcnt[MEMPHY_META_FRAMES];
+};
+
+static addr_t __bd_numfp(struct memphy_struct *mp)
+{
+   return mp->maxsz / MEMPHY_PAGESZ;
+}
+
+/* __fp_peek - metadata chunk of a frame, NULL if never used */
+static struct memphy_fpmeta *__fp_peek(struct memphy_struct *mp, addr_t fpn)
+{
+   return mp->fp_meta[fpn / MEMPHY_META_FRAMES];
+}
+
+/* __fp_meta - metadata chunk of a frame, created on first use */
+static struct memphy_fpmeta *__fp_meta(struct memphy_struct *mp, addr_t fpn)
+{
+   struct memphy_fpmeta **pm = &mp->fp_meta[fpn / MEMPHY_META_FRAMES];
+
+   if (*pm == NULL)
+      *pm = calloc(1, sizeof(struct memphy_fpmeta));
+   return *pm;
+}
+
+static void __bd_push(struct memphy_struct *mp, addr_t fpn, int order)
+{
+   struct memphy_fpmeta *m = __fp_meta(mp, fpn);
+   addr_t head = mp->bd_head[order];
+
+   m->next[MEMPHY_META_IDX(fpn)] = head;
+   m->prev[MEMPHY_META_IDX(fpn)] = PAGING_FPN_INVALID;
+   if (head != PAGING_FPN_INVALID)
+      __fp_meta(mp, head)->prev[MEMPHY_META_IDX(head)] = fpn;
+   mp->bd_head[order] = fpn;
+   m->order[MEMPHY_META_IDX(fpn)] = order + 1;
+}
+
+static void __bd_unlink(struct memphy_struct *mp, addr_t fpn, int order)
+{
+   struct memphy_fpmeta *m = __fp_meta(mp, fpn);
+   addr_t next = m->next[MEMPHY_META_IDX(fpn)];
+   addr_t prev = m->prev[MEMPHY_META_IDX(fpn)];
+
+   if (prev != PAGING_FPN_INVALID)
+      __fp_meta(mp, prev)->next[MEMPHY_META_IDX(prev)] = next;
+   else
+      mp->bd_head[order] = next;
+   if (next != PAGING_FPN_INVALID)
+      __fp_meta(mp, next)->prev[MEMPHY_META_IDX(next)] = prev;
+   m->order[MEMPHY_META_IDX(fpn)] = 0;
+}
+
+/* __bd_put - free a block, merging it with its buddy while possible */
+static void __bd_put(struct memphy_struct *mp, addr_t fpn, int order)
+{
+   struct memphy_fpmeta *m;
+   addr_t buddy;
+
+   while (order < MEMPHY_MAX_ORDER)
+   {
+      buddy = fpn ^ MEMPHY_BLKSZ(order);
+      if (buddy + MEMPHY_BLKSZ(order) > __bd_numfp(mp))
+         break;
+      m = __fp_peek(mp, buddy);
+      if (m == NULL || m->order[MEMPHY_META_IDX(buddy)] != order + 1)
+         break;
+
+      __bd_unlink(mp, buddy, order);
+      fpn &= ~MEMPHY_BLKSZ(order);
+      order++;
+   }
+
+   __bd_push(mp, fpn, order);
+}
+
+/* __bd_put_span - free [fpn, end) as the largest aligned blocks */
+static void __bd_put_span(struct memphy_struct *mp, addr_t fpn, addr_t end)
+{
+   int order;
+
+   while (fpn < end)
+   {
+      order = 0;
+      while (order < MEMPHY_MAX_ORDER &&
+             (fpn & (MEMPHY_BLKSZ(order + 1) - 1)) == 0 &&
+             fpn + MEMPHY_BLKSZ(order + 1) <= end)
+         order++;
+
+      __bd_put(mp, fpn, order);
+      fpn += MEMPHY_BLKSZ(order);
+   }
+}
+
+/* __bd_get - take a block of 2^order frames, splitting a larger one */
+static int __bd_get(struct memphy_struct *mp, int order, addr_t *retfpn)
+{
+   addr_t fpn;
+   int o;
+
+   for (o = order; o <= MEMPHY_MAX_ORDER; o++)
+      if (mp->bd_head[o] != PAGING_FPN_INVALID)
+         break;
+
+   if (o <= MEMPHY_MAX_ORDER)
+   {
+      fpn = mp->bd_head[o];
+      __bd_unlink(mp, fpn, o);
+   }
+   else if (mp->fp_fresh < mp->fp_fresh_end)
+   {
+      fpn = mp->fp_fresh;
+      mp->fp_fresh += MEMPHY_BLKSZ(MEMPHY_MAX_ORDER);
+      o = MEMPHY_MAX_ORDER;
+   }
+   else
+      return -1;
+
+   /* Hand the upper halves back until the block has the asked size */
+   while (o > order)
+   {
+      o--;
+      __bd_push(mp, fpn + MEMPHY_BLKSZ(o), o);
+   }
+
+   *retfpn = fpn;
+   return 0;
+}
+
+/* __bd_get_run - take @num contiguous frames, the tail of the block
+ * they are cut from goes back */
+static int __bd_get_run(struct memphy_struct *mp, int num, addr_t *retfpn)
+{
+   int order = 0;
+
+   while (MEMPHY_BLKSZ(order) < num)
+      order++;
+   if (order > MEMPHY_MAX_ORDER || __bd_get(mp, order, retfpn) != 0)
+      return -1;
+
+   __bd_put_span(mp, *retfpn + num, *retfpn + MEMPHY_BLKSZ(order));
+   return 0;
+}
+
 /*
  * MEMPHY_format-format MEMPHY device
  * @mp: memphy struct
@@ -127,45 +614,103 @@ int MEMPHY_write(struct memphy_struct *mp, addr_t addr, BYTE data)
 int MEMPHY_format(struct memphy_struct *mp, int pagesz)
 {
    /* This setting come with fixed constant PAGESZ */
-   int numfp = mp->maxsz / pagesz;
+   addr_t numfp = mp->maxsz / pagesz;
+   int order;
+
+   for (order = 0; order <= MEMPHY_MAX_ORDER; order++)
+      mp->bd_head[order] = PAGING_FPN_INVALID;
+   mp->fp_meta = NULL;
+   mp->fp_meta_cnt = 0;
+   mp->used_fp_list = NULL;
+   mp->fp_fresh = 0;
+   mp->fp_fresh_end = 0;
+   mp->free_fp_cnt = 0;
+
+   if (numfp == 0)
+      return -1;
 
-   struct framephy_struct *newfst, *fst;
-   int iter = 0;
+   /* Only a pointer per largest block, its frames get metadata once
+    * one of them is listed or handed out */
+   mp->fp_meta_cnt = (numfp + MEMPHY_META_FRAMES - 1) / MEMPHY_META_FRAMES;
+   mp->fp_meta = calloc(mp->fp_meta_cnt, sizeof(struct memphy_fpmeta *));
+
+   /* Only the tail short of a largest block is listed up front */
+   mp->fp_fresh_end = numfp & ~(MEMPHY_BLKSZ(MEMPHY_MAX_ORDER) - 1);
+   __bd_put_span(mp, mp->fp_fresh_end, numfp);
+   mp->free_fp_cnt = numfp;
+
+   return 0;
+}
+
+/*
+ * MEMPHY_get_freefp_n - take @num free frames at once
+ * @mp     : memphy struct
+ * @num    : number of frames
+ * @retfpn : array receiving the frames
+ * Either all frames are taken or none.  They come as one contiguous
+ * run while the allocator has one, frame by frame otherwise.
+ */
+int MEMPHY_get_freefp_n(struct memphy_struct *mp, int num, addr_t *retfpn)
+{
+   addr_t start;
+   int i;
 
-   if (numfp <= 0)
+   pthread_mutex_lock(&mp->fp_lock);
+   if (num <= 0 || mp->free_fp_cnt < num)
+   {
+      pthread_mutex_unlock(&mp->fp_lock);
       return -1;
-   /* Init head of free framephy list */
-   fst = malloc(sizeof(struct framephy_struct));
-   fst->fpn = iter;
-   mp->free_fp_list = fst;
+   }
 
-   /* We have list with first element, fill in the rest num-1 element member*/
-   for (iter = 1; iter < numfp; iter++)
+   if (__bd_get_run(mp, num, &start) == 0)
    {
-      newfst = malloc(sizeof(struct framephy_struct));
-      newfst->fpn = iter;
-      newfst->fp_next = NULL;
-      fst->fp_next = newfst;
-      fst = newfst;
+      for (i = 0; i < num; i++)
+         retfpn[i] = start + i;
    }
+   else
+   {
+      for (i = 0; i < num; i++)
+         __bd_get(mp, 0, &retfpn[i]);
+   }
+
+   for (i = 0; i < num; i++)
+      __fp_meta(mp, retfpn[i])->refcnt[MEMPHY_META_IDX(retfpn[i])] = 1;
+   mp->free_fp_cnt -= num;
+   pthread_mutex_unlock(&mp->fp_lock);
 
    return 0;
 }
 
 int MEMPHY_get_freefp(struct memphy_struct *mp, addr_t *retfpn)
 {
-   struct framephy_struct *fp = mp->free_fp_list;
+   return MEMPHY_get_freefp_n(mp, 1, retfpn);
+}
 
-   if (fp == NULL)
+/*
+ * MEMPHY_get_freefp_range - get a run of contiguous free frames
+ * @mp     : memphy struct
+ * @num    : number of frames, the run is aligned to it rounded up to a
+ *           power of two
+ * @retfpn : first frame of the run
+ */
+int MEMPHY_get_freefp_range(struct memphy_struct *mp, int num, addr_t *retfpn)
+{
+   addr_t it;
+
+   if (num <= 0 || mp->fp_meta == NULL)
       return -1;
 
-   *retfpn = fp->fpn;
-   mp->free_fp_list = fp->fp_next;
+   pthread_mutex_lock(&mp->fp_lock);
+   if (mp->free_fp_cnt < num || __bd_get_run(mp, num, retfpn) != 0)
+   {
+      pthread_mutex_unlock(&mp->fp_lock);
+      return -1;
+   }
 
-   /* MEMPHY is iteratively used up until its exhausted
-    * No garbage collector acting then it not been released
-    */
-   free(fp);
+   for (it = *retfpn; it < *retfpn + num; it++)
+      __fp_meta(mp, it)->refcnt[MEMPHY_META_IDX(it)] = 1;
+   mp->free_fp_cnt -= num;
+   pthread_mutex_unlock(&mp->fp_lock);
 
    return 0;
 }
@@ -175,7 +720,7 @@ int MEMPHY_dump(struct memphy_struct *mp)
    if (mp == NULL || mp->storage == NULL)
        return -1;
 
-   printf("=== MEMPHY DUMP (Max Size: %d) ===\n", mp->maxsz);
+   printf("=== MEMPHY DUMP (Max Size: %" PRIu64 ") ===\n", mp->maxsz);
    
    /* Only print non-zero bytes */
    addr_t i;
@@ -198,34 +743,206 @@ int MEMPHY_dump(struct memphy_struct *mp)
    return 0;
 }
 
+/*
+ * MEMPHY_ref_fp - take one more reference on an in-use frame
+ * @mp  : memphy struct
+ * @fpn : frame number
+ */
+int MEMPHY_ref_fp(struct memphy_struct *mp, addr_t fpn)
+{
+   int cnt;
+
+   if (mp == NULL || mp->fp_meta == NULL)
+      return -1;
+
+   pthread_mutex_lock(&mp->fp_lock);
+   cnt = ++__fp_meta(mp, fpn)->refcnt[MEMPHY_META_IDX(fpn)];
+   pthread_mutex_unlock(&mp->fp_lock);
+
+   return cnt;
+}
+
+/*
+ * MEMPHY_refcnt_fp - number of users of a frame
+ * @mp  : memphy struct
+ * @fpn : frame number
+ */
+int MEMPHY_refcnt_fp(struct memphy_struct *mp, addr_t fpn)
+{
+   struct memphy_fpmeta *m;
+   int cnt;
+
+   if (mp == NULL || mp->fp_meta == NULL)
+      return 0;
+
+   pthread_mutex_lock(&mp->fp_lock);
+   m = __fp_peek(mp, fpn);
+   cnt = (m != NULL) ? m->refcnt[MEMPHY_META_IDX(fpn)] : 0;
+   pthread_mutex_unlock(&mp->fp_lock);
+
+   return cnt;
+}
+
+/*
+ * MEMPHY_put_freefp - drop a reference on a frame
+ * The frame only goes back to the free list with its last user.
+ * Returns 1 when it did, 0 while others still hold it.
+ */
 int MEMPHY_put_freefp(struct memphy_struct *mp, addr_t fpn)
 {
-   struct framephy_struct *fp = mp->free_fp_list;
-   struct framephy_struct *newnode = malloc(sizeof(struct framephy_struct));
+   uint32_t *refcnt;
+
+   if (mp->fp_meta == NULL)
+      return -1;
+
+   pthread_mutex_lock(&mp->fp_lock);
+   refcnt = &__fp_meta(mp, fpn)->refcnt[MEMPHY_META_IDX(fpn)];
+   if (*refcnt > 1)
+   {
+      (*refcnt)--;
+      pthread_mutex_unlock(&mp->fp_lock);
+      return 0;
+   }
+   *refcnt = 0;
+
+   __bd_put(mp, fpn, 0);
+   mp->free_fp_cnt++;
+   pthread_mutex_unlock(&mp->fp_lock);
+
+   return 1;
+}
+
+/* __ioq_init - start a sequential device at frame 0 with an empty queue */
+static void __ioq_init(struct memphy_struct *mp)
+{
+   int i;
+
+   mp->cursor = 0;
+   mp->iosched = MEMPHY_IOSCHED_FIFO;
+   mp->seek_cost = MEMPHY_SEEK_COST;
+   mp->xfer_cost = MEMPHY_XFER_COST;
+   mp->io_clock = 0;
+   mp->io_dir = 1;
+   mp->ioq_cnt = 0;
+   mp->ioq_seq = 0;
+   memset(&mp->iostat, 0, sizeof(mp->iostat));
+
+   mp->ioq = calloc(MEMPHY_IOQ_MAX, sizeof(struct memphy_ioreq));
+   for (i = 0; i < MEMPHY_IOQ_MAX; i++)
+      mp->ioq[i].buf = malloc(MEMPHY_PAGESZ);
+}
+
+/*
+ * MEMPHY_unref_fp - drop a reference on a frame, keeping it listed used
+ * Returns the references left.  A frame left without any stays with
+ * the caller, nobody can take it, until MEMPHY_free_fp lists it free.
+ */
+int MEMPHY_unref_fp(struct memphy_struct *mp, addr_t fpn)
+{
+   uint32_t *refcnt;
+   int cnt;
+
+   if (mp->fp_meta == NULL)
+      return -1;
+
+   pthread_mutex_lock(&mp->fp_lock);
+   refcnt = &__fp_meta(mp, fpn)->refcnt[MEMPHY_META_IDX(fpn)];
+   if (*refcnt > 0)
+      (*refcnt)--;
+   cnt = *refcnt;
+   pthread_mutex_unlock(&mp->fp_lock);
+
+   return cnt;
+}
+
+/*
+ * MEMPHY_free_fp - list a frame without references as free
+ */
+int MEMPHY_free_fp(struct memphy_struct *mp, addr_t fpn)
+{
+   if (mp->fp_meta == NULL)
+      return -1;
 
-   /* Create new node with value fpn */
-   newnode->fpn = fpn;
-   newnode->fp_next = fp;
-   mp->free_fp_list = newnode;
+   pthread_mutex_lock(&mp->fp_lock);
+   __fp_meta(mp, fpn)->refcnt[MEMPHY_META_IDX(fpn)] = 0;
+   __bd_put(mp, fpn, 0);
+   mp->free_fp_cnt++;
+   pthread_mutex_unlock(&mp->fp_lock);
 
    return 0;
 }
 
 /*
  * Init MEMPHY struct
+ * Storage is reserved, not committed, the host hands out zero pages as
+ * they get touched.
  */
-int init_memphy(struct memphy_struct *mp, addr_t max_size, int randomflg)
+int init_memphy(struct memphy_struct *mp, uint64_t max_size, int randomflg)
 {
-   mp->storage = (BYTE *)malloc(max_size * sizeof(BYTE));
+   void *storage = NULL;
+
+   if (max_size > 0)
+   {
+      storage = mmap(NULL, max_size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+      if (storage == MAP_FAILED)
+         return -1;
+   }
+
+   mp->storage = (BYTE *)storage;
    mp->maxsz = max_size;
-   memset(mp->storage, 0, max_size * sizeof(BYTE));
+   pthread_mutex_init(&mp->fp_lock, NULL);
 
-   MEMPHY_format(mp, PAGING_PAGESZ);
+   MEMPHY_format(mp, MEMPHY_PAGESZ);
 
    mp->rdmflg = (randomflg != 0) ? 1 : 0;
 
    if (!mp->rdmflg) /* Not Ramdom acess device, then it serial device*/
-      mp->cursor = 0;
+      __ioq_init(mp);
+   return 0;
+}
+
+/*
+ * init_memphy_file - init a MEMPHY device backed by a host file
+ * @path: file mapped shared as the device storage, truncated to
+ *        @max_size so the device starts zeroed like init_memphy
+ * The contents stay in the file after exit.
+ */
+int init_memphy_file(struct memphy_struct *mp, uint64_t max_size, int randomflg,
+                     const char *path)
+{
+   int fd;
+   void *storage;
+
+   /* An unconfigured device has nothing to map */
+   if (max_size == 0)
+      return init_memphy(mp, max_size, randomflg);
+
+   fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+   if (fd < 0)
+      return -1;
+
+   if (ftruncate(fd, max_size) != 0)
+   {
+      close(fd);
+      return -1;
+   }
+
+   storage = mmap(NULL, max_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   close(fd);
+   if (storage == MAP_FAILED)
+      return -1;
+
+   mp->storage = (BYTE *)storage;
+   mp->maxsz = max_size;
+   pthread_mutex_init(&mp->fp_lock, NULL);
+
+   MEMPHY_format(mp, MEMPHY_PAGESZ);
+
+   mp->rdmflg = (randomflg != 0) ? 1 : 0;
+
+   if (!mp->rdmflg)
+      __ioq_init(mp);
    return 0;
 }
 
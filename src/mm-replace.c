@@ -0,0 +1,604 @@
+/*
+ * Copyright (C) 2026 pdnguyen of HCMC University of Technology VNU-HCM
+ */
+
+/* LamiaAtrium release
+ * Source Code License Grant: The authors hereby grant to Licensee
+ * personal permission to use and modify the Licensed Source Code
+ * for the sole purpose of studying while attending the course CO2018.
+ */
+
+//#ifdef MM_PAGING
+/*
+ * PAGING based Memory Management
+ * Page replacement policies mm/mm-replace.c
+ *
+ * Every mm keeps its resident pages in the private state of the policy
+ * chosen at startup.  Policies only learn about accesses through the
+ * referenced bit of the PTE, like a real MMU would tell them.
+ */
+
+#include "mm.h"
+#include "mm64.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+struct pgrepl_ops {
+   const char *name;
+   void *(*init)(void);
+   void *(*dup)(void *priv);
+   void (*release)(void *priv);
+   /* A page became resident */
+   int (*add)(struct mm_struct *mm, void *priv, addr_t pgn);
+   /* Pick a resident page to evict and forget it */
+   int (*victim)(struct mm_struct *mm, void *priv, addr_t *pgn);
+};
+
+/* RAM frames, bound of the ARC histories */
+static int pgrepl_nframes = 1;
+
+/*
+ * Growable circular queue of page numbers
+ */
+struct pgq {
+   addr_t *buf;
+   int sz;
+   int head;
+   int cnt;
+};
+
+static void pgq_push(struct pgq *q, addr_t pgn)
+{
+   addr_t *buf;
+   int sz, i;
+
+   if (q->cnt == q->sz)
+   {
+      sz = q->sz ? q->sz * 2 : PAGING64_PT_SZ;
+      buf = malloc(sz * sizeof(addr_t));
+      for (i = 0; i < q->cnt; i++)
+         buf[i] = q->buf[(q->head + i) % q->sz];
+      free(q->buf);
+      q->buf = buf;
+      q->sz = sz;
+      q->head = 0;
+   }
+
+   q->buf[(q->head + q->cnt) % q->sz] = pgn;
+   q->cnt++;
+}
+
+static int pgq_pop(struct pgq *q, addr_t *pgn)
+{
+   if (q->cnt == 0)
+      return -1;
+
+   *pgn = q->buf[q->head];
+   q->head = (q->head + 1) % q->sz;
+   q->cnt--;
+   return 0;
+}
+
+static void pgq_copy(struct pgq *dst, struct pgq *src)
+{
+   *dst = *src;
+   if (src->sz > 0)
+   {
+      dst->buf = malloc(src->sz * sizeof(addr_t));
+      memcpy(dst->buf, src->buf, src->sz * sizeof(addr_t));
+   }
+}
+
+/*
+ * FIFO - evict the page resident for the longest time
+ */
+static void *fifo_init(void)
+{
+   return calloc(1, sizeof(struct pgq));
+}
+
+static void *fifo_dup(void *priv)
+{
+   struct pgq *q = malloc(sizeof(struct pgq));
+
+   pgq_copy(q, priv);
+   return q;
+}
+
+static void fifo_release(void *priv)
+{
+   free(((struct pgq *)priv)->buf);
+   free(priv);
+}
+
+static int fifo_add(struct mm_struct *mm, void *priv, addr_t pgn)
+{
+   pgq_push(priv, pgn);
+   return 0;
+}
+
+static int fifo_victim(struct mm_struct *mm, void *priv, addr_t *pgn)
+{
+   return pgq_pop(priv, pgn);
+}
+
+/*
+ * Resident pages in a ring swept by a hand, shared by CLOCK, LRU and LFU.
+ * Evicted pages leave an empty slot the next page added reuses, so it is
+ * the last one the hand looks at again.
+ */
+struct pgslot {
+   addr_t pgn;
+   uint32_t cnt; /* age or use count */
+};
+
+struct pgring {
+   struct pgslot *slot;
+   int sz;   /* allocated slots */
+   int len;  /* slots in use, including empty ones */
+   int cnt;  /* resident pages */
+   int hand;
+   int hole; /* last emptied slot, -1 if none */
+};
+
+static void *ring_init(void)
+{
+   struct pgring *r = calloc(1, sizeof(struct pgring));
+
+   r->hole = -1;
+   return r;
+}
+
+static void *ring_dup(void *priv)
+{
+   struct pgring *src = priv;
+   struct pgring *r = malloc(sizeof(struct pgring));
+
+   *r = *src;
+   if (src->sz > 0)
+   {
+      r->slot = malloc(src->sz * sizeof(struct pgslot));
+      memcpy(r->slot, src->slot, src->len * sizeof(struct pgslot));
+   }
+   return r;
+}
+
+static void ring_release(void *priv)
+{
+   free(((struct pgring *)priv)->slot);
+   free(priv);
+}
+
+/* ring_add - new pages start referenced, as the access faulting them in */
+static int ring_add(struct mm_struct *mm, void *priv, addr_t pgn)
+{
+   struct pgring *r = priv;
+   int i, j;
+
+   pte_mkyoung(mm, pgn);
+
+   if (r->hole >= 0 && r->hole < r->len &&
+       r->slot[r->hole].pgn == PAGING_PGN_INVALID)
+   {
+      i = r->hole;
+      r->hole = -1;
+   }
+   else
+   {
+      if (r->len == r->sz)
+      {
+         if (r->len > 0 && r->cnt <= r->len / 2)
+         {
+            /* Mostly empty slots: squeeze them out, keeping the ring order */
+            for (i = j = 0; i < r->len; i++)
+            {
+               if (i == r->hand)
+                  r->hand = j;
+               if (r->slot[i].pgn != PAGING_PGN_INVALID)
+                  r->slot[j++] = r->slot[i];
+            }
+            r->len = j;
+            r->hole = -1;
+         }
+         else
+         {
+            r->sz = r->sz ? r->sz * 2 : PAGING64_PT_SZ;
+            r->slot = realloc(r->slot, r->sz * sizeof(struct pgslot));
+         }
+      }
+      i = r->len++;
+   }
+
+   r->slot[i].pgn = pgn;
+   r->slot[i].cnt = 0;
+   r->cnt++;
+   return 0;
+}
+
+static void ring_take(struct pgring *r, int i, addr_t *pgn)
+{
+   *pgn = r->slot[i].pgn;
+   r->slot[i].pgn = PAGING_PGN_INVALID;
+   r->hole = i;
+   r->cnt--;
+}
+
+/*
+ * CLOCK - the hand gives referenced pages a second chance and takes the
+ * first one not used since its last pass
+ */
+static int clock_victim(struct mm_struct *mm, void *priv, addr_t *pgn)
+{
+   struct pgring *r = priv;
+   int step;
+
+   if (r->cnt == 0)
+      return -1;
+
+   /* Two sweeps at most, the first one clears every referenced bit */
+   for (step = 0; step <= 2 * r->len; step++)
+   {
+      if (r->hand >= r->len)
+         r->hand = 0;
+
+      if (r->slot[r->hand].pgn == PAGING_PGN_INVALID)
+      {
+         r->hole = r->hand++;
+         continue;
+      }
+      if (pte_test_and_clear_young(mm, r->slot[r->hand].pgn))
+      {
+         r->hand++;
+         continue;
+      }
+
+      ring_take(r, r->hand++, pgn);
+      return 0;
+   }
+
+   return -1;
+}
+
+/*
+ * __ring_sweep_min - update every page from its referenced bit, take the
+ * one with the smallest count.  Ties go to the first page after the hand.
+ * @aging: shift the bit into an 8 bit history instead of counting it
+ */
+static int __ring_sweep_min(struct mm_struct *mm, struct pgring *r,
+                            int aging, addr_t *pgn)
+{
+   struct pgslot *s;
+   int best = -1;
+   int i, k, young;
+
+   if (r->cnt == 0)
+      return -1;
+
+   for (k = 0; k < r->len; k++)
+   {
+      i = (r->hand + k) % r->len;
+      s = &r->slot[i];
+      if (s->pgn == PAGING_PGN_INVALID)
+         continue;
+
+      young = pte_test_and_clear_young(mm, s->pgn);
+      if (aging)
+         s->cnt = (s->cnt >> 1) | (young ? 0x80 : 0);
+      else
+         s->cnt += young;
+
+      if (best < 0 || s->cnt < r->slot[best].cnt)
+         best = i;
+   }
+
+   r->hand = (best + 1) % r->len;
+   ring_take(r, best, pgn);
+   return 0;
+}
+
+/*
+ * LRU approximation by aging - the page unused for the most passes goes
+ */
+static int lru_victim(struct mm_struct *mm, void *priv, addr_t *pgn)
+{
+   return __ring_sweep_min(mm, priv, 1, pgn);
+}
+
+/*
+ * LFU - the page seen referenced in the fewest passes goes
+ */
+static int lfu_victim(struct mm_struct *mm, void *priv, addr_t *pgn)
+{
+   return __ring_sweep_min(mm, priv, 0, pgn);
+}
+
+/*
+ * ARC, in its CLOCK form (CAR) since only referenced bits are known.
+ * T1 holds pages seen once, T2 pages seen again, B1/B2 remember pages
+ * recently evicted from each.  A fault on a remembered page moves the
+ * target size p of T1 towards the list that would have kept it.
+ */
+#define ARC_HASH_SZ 1024
+
+struct arc_ghost {
+   addr_t pgn;
+   int list;
+   struct arc_ghost *prev, *next; /* towards MRU, towards LRU */
+   struct arc_ghost *hnext;
+};
+
+struct arc_state {
+   struct pgq t1, t2;
+   struct arc_ghost *mru[2], *lru[2];
+   int bcnt[2];
+   struct arc_ghost *hash[ARC_HASH_SZ];
+   int p;
+};
+
+static struct arc_ghost *arc_ghost_find(struct arc_state *s, addr_t pgn)
+{
+   struct arc_ghost *g = s->hash[pgn % ARC_HASH_SZ];
+
+   while (g != NULL && g->pgn != pgn)
+      g = g->hnext;
+   return g;
+}
+
+static void arc_ghost_unlink(struct arc_state *s, struct arc_ghost *g)
+{
+   struct arc_ghost **pg = &s->hash[g->pgn % ARC_HASH_SZ];
+
+   while (*pg != g)
+      pg = &(*pg)->hnext;
+   *pg = g->hnext;
+
+   if (g->prev) g->prev->next = g->next;
+   else s->mru[g->list] = g->next;
+   if (g->next) g->next->prev = g->prev;
+   else s->lru[g->list] = g->prev;
+   s->bcnt[g->list]--;
+
+   free(g);
+}
+
+static void arc_ghost_push(struct arc_state *s, int list, addr_t pgn)
+{
+   struct arc_ghost *g = malloc(sizeof(struct arc_ghost));
+
+   g->pgn = pgn;
+   g->list = list;
+   g->prev = NULL;
+   g->next = s->mru[list];
+   if (g->next) g->next->prev = g;
+   else s->lru[list] = g;
+   s->mru[list] = g;
+   s->bcnt[list]++;
+
+   g->hnext = s->hash[pgn % ARC_HASH_SZ];
+   s->hash[pgn % ARC_HASH_SZ] = g;
+}
+
+static void *arc_init(void)
+{
+   return calloc(1, sizeof(struct arc_state));
+}
+
+static void *arc_dup(void *priv)
+{
+   struct arc_state *src = priv;
+   struct arc_state *s = calloc(1, sizeof(struct arc_state));
+   struct arc_ghost *g;
+   int list;
+
+   pgq_copy(&s->t1, &src->t1);
+   pgq_copy(&s->t2, &src->t2);
+   s->p = src->p;
+
+   /* Rebuild the histories from their LRU end to keep the order */
+   for (list = 0; list < 2; list++)
+      for (g = src->lru[list]; g != NULL; g = g->prev)
+         arc_ghost_push(s, list, g->pgn);
+
+   return s;
+}
+
+static void arc_release(void *priv)
+{
+   struct arc_state *s = priv;
+   int list;
+
+   for (list = 0; list < 2; list++)
+      while (s->lru[list] != NULL)
+         arc_ghost_unlink(s, s->lru[list]);
+
+   free(s->t1.buf);
+   free(s->t2.buf);
+   free(s);
+}
+
+/* arc_add - new pages start unreferenced, only later accesses count */
+static int arc_add(struct mm_struct *mm, void *priv, addr_t pgn)
+{
+   struct arc_state *s = priv;
+   struct arc_ghost *g = arc_ghost_find(s, pgn);
+   int c = pgrepl_nframes;
+   int d;
+
+   if (g == NULL)
+   {
+      /* Keep the history within what RAM could hold twice */
+      if (s->t1.cnt + s->bcnt[0] >= c && s->bcnt[0] > 0)
+         arc_ghost_unlink(s, s->lru[0]);
+      else if (s->t1.cnt + s->t2.cnt + s->bcnt[0] + s->bcnt[1] >= 2 * c &&
+               s->bcnt[1] > 0)
+         arc_ghost_unlink(s, s->lru[1]);
+
+      pgq_push(&s->t1, pgn);
+      return 0;
+   }
+
+   if (g->list == 0)
+   { /* T1 was too small to keep it */
+      d = s->bcnt[1] / s->bcnt[0];
+      s->p += (d < 1) ? 1 : d;
+      if (s->p > c)
+         s->p = c;
+   }
+   else
+   { /* T2 was too small to keep it */
+      d = s->bcnt[0] / s->bcnt[1];
+      s->p -= (d < 1) ? 1 : d;
+      if (s->p < 0)
+         s->p = 0;
+   }
+
+   arc_ghost_unlink(s, g);
+   pgq_push(&s->t2, pgn);
+   return 0;
+}
+
+static int arc_victim(struct mm_struct *mm, void *priv, addr_t *pgn)
+{
+   struct arc_state *s = priv;
+   addr_t pg;
+
+   if (s->t1.cnt + s->t2.cnt == 0)
+      return -1;
+
+   /* Each round clears one referenced bit, so this ends within two
+    * sweeps of T1 and T2 */
+   while (1)
+   {
+      if (s->t1.cnt > 0 &&
+          (s->t1.cnt >= (s->p > 1 ? s->p : 1) || s->t2.cnt == 0))
+      {
+         pgq_pop(&s->t1, &pg);
+         if (!pte_test_and_clear_young(mm, pg))
+         {
+            arc_ghost_push(s, 0, pg);
+            break;
+         }
+         pgq_push(&s->t2, pg);
+      }
+      else
+      {
+         pgq_pop(&s->t2, &pg);
+         if (!pte_test_and_clear_young(mm, pg))
+         {
+            arc_ghost_push(s, 1, pg);
+            break;
+         }
+         pgq_push(&s->t2, pg);
+      }
+   }
+
+   *pgn = pg;
+   return 0;
+}
+
+static struct pgrepl_ops pgrepl_policies[] = {
+   { "fifo",  fifo_init, fifo_dup, fifo_release, fifo_add, fifo_victim },
+   { "clock", ring_init, ring_dup, ring_release, ring_add, clock_victim },
+   { "lru",   ring_init, ring_dup, ring_release, ring_add, lru_victim },
+   { "lfu",   ring_init, ring_dup, ring_release, ring_add, lfu_victim },
+   { "arc",   arc_init,  arc_dup,  arc_release,  arc_add,  arc_victim },
+};
+
+static struct pgrepl_ops *pgrepl = &pgrepl_policies[1];
+
+/* Counters of the processes already gone */
+static struct pgrepl_stat pgrepl_total;
+static pthread_mutex_t pgrepl_stat_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * pgrepl_init - choose the replacement policy, before any mm exists
+ * @name: policy name, NULL keeps the default
+ * @mram: RAM device, sizes the histories of ARC
+ */
+int pgrepl_init(const char *name, struct memphy_struct *mram)
+{
+   int i;
+   int n = sizeof(pgrepl_policies) / sizeof(pgrepl_policies[0]);
+
+   pgrepl_nframes = mram->maxsz / PAGING64_PAGESZ;
+   if (pgrepl_nframes < 1)
+      pgrepl_nframes = 1;
+
+   if (name == NULL)
+      return 0;
+
+   for (i = 0; i < n; i++)
+      if (strcmp(pgrepl_policies[i].name, name) == 0)
+      {
+         pgrepl = &pgrepl_policies[i];
+         return 0;
+      }
+
+   return -1;
+}
+
+int pgrepl_mm_init(struct mm_struct *mm)
+{
+   memset(&mm->pgstat, 0, sizeof(struct pgrepl_stat));
+   mm->pgrepl = pgrepl->init();
+   return 0;
+}
+
+int pgrepl_mm_dup(struct mm_struct *mm, struct mm_struct *src)
+{
+   memset(&mm->pgstat, 0, sizeof(struct pgrepl_stat));
+   mm->pgrepl = pgrepl->dup(src->pgrepl);
+   return 0;
+}
+
+/*
+ * pgrepl_mm_release - drop the policy state of a dying mm
+ * Its counters are kept for the final report.
+ */
+int pgrepl_mm_release(struct mm_struct *mm)
+{
+   pthread_mutex_lock(&pgrepl_stat_lock);
+   pgrepl_total.access += mm->pgstat.access;
+   pgrepl_total.fault += mm->pgstat.fault;
+   pgrepl_total.majfault += mm->pgstat.majfault;
+   pgrepl_total.evict += mm->pgstat.evict;
+   pgrepl_total.clean += mm->pgstat.clean;
+   pgrepl_total.readahead += mm->pgstat.readahead;
+   pthread_mutex_unlock(&pgrepl_stat_lock);
+
+   if (mm->pgrepl != NULL)
+      pgrepl->release(mm->pgrepl);
+   mm->pgrepl = NULL;
+   return 0;
+}
+
+/* pgrepl_add - hand a newly resident page to the policy */
+int pgrepl_add(struct mm_struct *mm, addr_t pgn)
+{
+   return pgrepl->add(mm, mm->pgrepl, pgn);
+}
+
+/* find_victim_page - find victim page */
+int find_victim_page(struct mm_struct *mm, addr_t *retpgn)
+{
+   return pgrepl->victim(mm, mm->pgrepl, retpgn);
+}
+
+/*
+ * pgrepl_report - print the counters of the policy in use
+ */
+void pgrepl_report(void)
+{
+   struct pgrepl_stat *st = &pgrepl_total;
+
+   pthread_mutex_lock(&pgrepl_stat_lock);
+   printf("Page replacement %s: accesses %lu faults %lu (swap-in %lu) "
+          "evictions %lu (clean %lu) read-ahead %lu miss ratio %.4f\n",
+          pgrepl->name, st->access, st->fault, st->majfault, st->evict,
+          st->clean, st->readahead, st->access ? (double)st->fault / st->access : 0.0);
+   pthread_mutex_unlock(&pgrepl_stat_lock);
+}
+
+//#endif
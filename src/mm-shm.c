@@ -0,0 +1,224 @@
+/*
+ * Copyright (C) 2026 pdnguyen of HCMC University of Technology VNU-HCM
+ */
+
+/* LamiaAtrium release
+ * Source Code License Grant: The authors hereby grant to Licensee
+ * personal permission to use and modify the Licensed Source Code
+ * for the sole purpose of studying while attending the course CO2018.
+ */
+
+//#ifdef MM_PAGING
+/*
+ * PAGING based Memory Management
+ * Shared memory segments mm/mm-shm.c
+ *
+ * A segment owns one reference on each of its resident frames, every
+ * page table mapping the frame holds another.  Evicting a shared page
+ * only unmaps it from one space; the frame goes out to swap once the
+ * segment is its last user, so there is never more than one copy of a
+ * page.  Spaces fault it back in through the segment.
+ */
+
+#include "mm.h"
+#include "mm64.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+
+struct shm_page {
+   addr_t fpn;     /* resident frame, PAGING_FPN_INVALID if none */
+   int swptyp;     /* swap slot while not resident */
+   addr_t swpoff;
+   int swapped;
+};
+
+struct shm_segment {
+   int key;
+   addr_t size;
+   addr_t npages;
+   struct shm_page *pages;
+   struct shm_segment *next;
+};
+
+static struct shm_segment *shm_segs;
+static pthread_mutex_t shm_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct shm_segment *__shm_find(int key)
+{
+   struct shm_segment *seg;
+
+   for (seg = shm_segs; seg != NULL; seg = seg->next)
+      if (seg->key == key)
+         return seg;
+
+   return NULL;
+}
+
+static void __page_clear(struct memphy_struct *mram, addr_t fpn)
+{
+   static const BYTE zero[PAGING64_PAGESZ];
+
+   MEMPHY_write_page(mram, fpn, zero);
+}
+
+/*
+ * shm_get - find or create the segment of a key
+ * @size: bytes, an existing segment must be at least that large
+ * Returns the key, which names the segment, or -1.
+ */
+int shm_get(int key, addr_t size)
+{
+   struct shm_segment *seg;
+   addr_t i;
+
+   if (size == 0)
+      return -1;
+
+   pthread_mutex_lock(&shm_lock);
+   seg = __shm_find(key);
+   if (seg != NULL)
+   {
+      pthread_mutex_unlock(&shm_lock);
+      return (size <= seg->size) ? key : -1;
+   }
+
+   seg = malloc(sizeof(struct shm_segment));
+   seg->key = key;
+   seg->size = size;
+   seg->npages = DIV_ROUND_UP(size, PAGING64_PAGESZ);
+   seg->pages = malloc(seg->npages * sizeof(struct shm_page));
+   for (i = 0; i < seg->npages; i++)
+   {
+      seg->pages[i].fpn = PAGING_FPN_INVALID;
+      seg->pages[i].swapped = 0;
+   }
+
+   seg->next = shm_segs;
+   shm_segs = seg;
+   pthread_mutex_unlock(&shm_lock);
+
+   return key;
+}
+
+/*
+ * shm_attach - map a segment into a new area of the caller
+ * @rgid: region handle bound to the segment
+ * @addr: start of the area
+ * The caller holds its mm lock.
+ */
+int shm_attach(struct pcb_t *caller, int key, int rgid, addr_t *addr)
+{
+   struct mm_struct *mm = caller->mm;
+   struct shm_segment *seg;
+   struct vm_area_struct *vma;
+   addr_t len;
+
+   pthread_mutex_lock(&shm_lock);
+   seg = __shm_find(key);
+   pthread_mutex_unlock(&shm_lock);
+   if (seg == NULL)
+      return -1;
+
+   len = seg->npages * PAGING64_PAGESZ;
+   if (len > mm->mmap_base)
+      return -1;
+
+   /* Pages are bound on touch, nothing to map yet */
+   vma = vm_area_create(mm, mm->mmap_base - len, mm->mmap_base, VM_SHARED);
+   if (vma == NULL)
+      return -1;
+   vma->vm_shm = seg;
+
+   if (symrg_bind(mm, rgid, vma->vm_start, vma->vm_start + seg->size) != 0)
+   {
+      vm_area_unlink(mm, vma);
+      return -1;
+   }
+
+   mm->mmap_base = vma->vm_start;
+   *addr = vma->vm_start;
+   return 0;
+}
+
+/*
+ * shm_getpage - frame of a segment page for a faulting space
+ * @newfpn: free frame taken beforehand, faults may evict and must not
+ *          run under the segment lock
+ * @fpn   : the frame to map, it comes with a reference for the mapping
+ * Returns 0 if newfpn is not needed, 1 if it got cleared for a new
+ * page and 2 if it got read back from swap.
+ */
+int shm_getpage(struct memphy_struct *mram, struct shm_segment *seg, addr_t idx,
+                addr_t newfpn, addr_t *fpn)
+{
+   struct shm_page *pg;
+   int ret;
+
+   if (idx >= seg->npages)
+      return -1;
+
+   pthread_mutex_lock(&shm_lock);
+   pg = &seg->pages[idx];
+
+   if (pg->fpn != PAGING_FPN_INVALID)
+   {
+      MEMPHY_ref_fp(mram, pg->fpn);
+      *fpn = pg->fpn;
+      pthread_mutex_unlock(&shm_lock);
+      return 0;
+   }
+
+   if (pg->swapped)
+   {
+      swap_readpage(mram, newfpn, pg->swptyp, pg->swpoff);
+      swap_put_slot(pg->swptyp, pg->swpoff);
+      pg->swapped = 0;
+      ret = 2;
+   }
+   else
+   {
+      __page_clear(mram, newfpn);
+      ret = 1;
+   }
+
+   /* One reference for the segment, one for the mapping */
+   pg->fpn = newfpn;
+   MEMPHY_ref_fp(mram, newfpn);
+   *fpn = newfpn;
+   pthread_mutex_unlock(&shm_lock);
+
+   return ret;
+}
+
+/*
+ * shm_putpage - drop a mapping of a segment page
+ * @swptyp, @swpoff: free swap slot for the page, swptyp -1 for none
+ * Once no space maps the frame any more it is written to the slot and
+ * freed.  Returns 1 if the slot got used, 0 if not.
+ */
+int shm_putpage(struct memphy_struct *mram, struct shm_segment *seg, addr_t idx,
+                addr_t fpn, int swptyp, addr_t swpoff)
+{
+   struct shm_page *pg = &seg->pages[idx];
+   int used = 0;
+
+   pthread_mutex_lock(&shm_lock);
+   MEMPHY_put_freefp(mram, fpn);
+
+   if (swptyp >= 0 && pg->fpn == fpn && MEMPHY_refcnt_fp(mram, fpn) == 1)
+   {
+      swap_writepage(mram, fpn, swptyp, swpoff);
+      pg->fpn = PAGING_FPN_INVALID;
+      pg->swptyp = swptyp;
+      pg->swpoff = swpoff;
+      pg->swapped = 1;
+      MEMPHY_put_freefp(mram, fpn);
+      used = 1;
+   }
+   pthread_mutex_unlock(&shm_lock);
+
+   return used;
+}
+
+//#endif
@@ -0,0 +1,398 @@
+/*
+ * Copyright (C) 2026 pdnguyen of HCMC University of Technology VNU-HCM
+ */
+
+/* LamiaAtrium release
+ * Source Code License Grant: The authors hereby grant to Licensee
+ * personal permission to use and modify the Licensed Source Code
+ * for the sole purpose of studying while attending the course CO2018.
+ */
+
+//#ifdef MM_PAGING
+/*
+ * PAGING based Memory Management
+ * Swap device management mm/mm-swap.c
+ *
+ * A swap slot is named by its device (the swap type of the PTE) and its
+ * frame on that device.  Slots come from the configured devices in
+ * priority order (config order, the next one only once the previous is
+ * full), or striped round robin over all of them.  Clusters of
+ * slots are contiguous frames of a single device.  Requests to a
+ * sequential device wait in its queue until the batch they are part of
+ * is unplugged.
+ *
+ * A page read back in keeps its slot in the swap cache, indexed by the
+ * RAM frame, until the page gets written or its frame freed.  Evicting
+ * it again before that only needs to point the PTE back at the slot.
+ */
+
+#include "mm.h"
+#include "mm64.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+static struct memphy_struct *swap_devs[PAGING_MAX_MMSWP];
+static int swap_nr;
+static int swap_stripe;
+static int swap_next; /* round robin cursor */
+static pthread_mutex_t swap_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Slot still holding a copy of a RAM frame, swap type -1 for none */
+static struct memphy_struct *swap_cache_mram;
+static int *swap_cache_typ;
+static addr_t *swap_cache_off;
+static addr_t swap_cache_nr;
+static pthread_mutex_t swap_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * swap_init - register the swap devices
+ * @mswp  : devices as configured, unused ones have no frame
+ * @nr    : number of devices
+ * @mode  : "prio" (default when NULL) or "stripe"
+ */
+int swap_init(struct memphy_struct *mswp, int nr, const char *mode)
+{
+   int i;
+
+   if (mode == NULL || strcmp(mode, "prio") == 0)
+      swap_stripe = 0;
+   else if (strcmp(mode, "stripe") == 0)
+      swap_stripe = 1;
+   else
+      return -1;
+
+   /* The swap type of a PTE indexes the configured devices */
+   swap_nr = (nr < PAGING_MAX_MMSWP) ? nr : PAGING_MAX_MMSWP;
+   for (i = 0; i < swap_nr; i++)
+      swap_devs[i] = (mswp[i].free_fp_cnt > 0) ? &mswp[i] : NULL;
+   swap_next = 0;
+
+   return 0;
+}
+
+/*
+ * swap_device - device holding a swap type, NULL if not configured
+ */
+struct memphy_struct *swap_device(int swptyp)
+{
+   if (swptyp < 0 || swptyp >= swap_nr)
+      return NULL;
+
+   return swap_devs[swptyp];
+}
+
+/*
+ * swap_get_slot - take a free swap slot
+ * @swptyp: device of the slot
+ * @swpoff: frame on the device
+ */
+int swap_get_slot(int *swptyp, addr_t *swpoff)
+{
+   int first, i, typ;
+
+   pthread_mutex_lock(&swap_lock);
+   first = swap_stripe ? swap_next : 0;
+   if (swap_stripe && swap_nr > 0)
+      swap_next = (swap_next + 1) % swap_nr;
+   pthread_mutex_unlock(&swap_lock);
+
+   for (i = 0; i < swap_nr; i++)
+   {
+      typ = (first + i) % swap_nr;
+      if (swap_devs[typ] == NULL)
+         continue;
+
+      if (MEMPHY_get_freefp(swap_devs[typ], swpoff) == 0)
+      {
+         *swptyp = typ;
+         return 0;
+      }
+   }
+
+   return -1;
+}
+
+/*
+ * swap_get_cluster - take a run of contiguous free swap slots
+ * @num   : slots wanted, fewer come back when no device has such a run
+ * @swptyp: device of the run
+ * @swpoff: first frame of the run on the device
+ * Returns the number of slots taken, 0 if swap is full.
+ */
+int swap_get_cluster(int num, int *swptyp, addr_t *swpoff)
+{
+   int first, i, typ;
+
+   pthread_mutex_lock(&swap_lock);
+   first = swap_stripe ? swap_next : 0;
+   if (swap_stripe && swap_nr > 0)
+      swap_next = (swap_next + 1) % swap_nr;
+   pthread_mutex_unlock(&swap_lock);
+
+   for (; num > 1; num /= 2)
+      for (i = 0; i < swap_nr; i++)
+      {
+         typ = (first + i) % swap_nr;
+         if (swap_devs[typ] != NULL &&
+             MEMPHY_get_freefp_range(swap_devs[typ], num, swpoff) == 0)
+         {
+            *swptyp = typ;
+            return num;
+         }
+      }
+
+   return (swap_get_slot(swptyp, swpoff) == 0) ? 1 : 0;
+}
+
+/*
+ * swap_put_slot - drop a reference on a swap slot
+ * The compressed copy of a slot goes away with its last user, before
+ * the slot is free for someone else to store a page in.
+ */
+int swap_put_slot(int swptyp, addr_t swpoff)
+{
+   struct memphy_struct *mp = swap_device(swptyp);
+
+   if (mp == NULL)
+      return -1;
+
+   if (MEMPHY_unref_fp(mp, swpoff) == 0)
+   {
+      zswap_invalidate(swptyp, swpoff);
+      MEMPHY_free_fp(mp, swpoff);
+   }
+
+   return 0;
+}
+
+/*
+ * swap_ref_slot - share a swap slot with one more page table
+ */
+int swap_ref_slot(int swptyp, addr_t swpoff)
+{
+   struct memphy_struct *mp = swap_device(swptyp);
+
+   if (mp == NULL)
+      return -1;
+
+   return MEMPHY_ref_fp(mp, swpoff);
+}
+
+/*
+ * swap_writepage - save a RAM frame to a swap slot
+ * The compressed pool gets the first try, the device the rest.
+ */
+int swap_writepage(struct memphy_struct *mram, addr_t fpn, int swptyp, addr_t swpoff)
+{
+   if (zswap_store(mram, fpn, swptyp, swpoff) == 0)
+      return 0;
+
+   return __swap_cp_page(mram, fpn, swap_device(swptyp), swpoff);
+}
+
+/*
+ * swap_readpage - fill a RAM frame from a swap slot
+ */
+int swap_readpage(struct memphy_struct *mram, addr_t fpn, int swptyp, addr_t swpoff)
+{
+   if (zswap_load(mram, fpn, swptyp, swpoff) == 0)
+      return 0;
+
+   return __swap_cp_page(swap_device(swptyp), swpoff, mram, fpn);
+}
+
+/*
+ * swap_submit_write - like swap_writepage, a sequential device only
+ * gets the page by swap_unplug, the frame is free to go at once
+ */
+int swap_submit_write(struct memphy_struct *mram, addr_t fpn, int swptyp, addr_t swpoff)
+{
+   if (zswap_store(mram, fpn, swptyp, swpoff) == 0)
+      return 0;
+
+   return MEMPHY_submit(swap_device(swptyp), swpoff, mram, fpn, 1);
+}
+
+/*
+ * swap_submit_read - like swap_readpage, the frame of a sequential
+ * device is only filled by swap_unplug
+ */
+int swap_submit_read(struct memphy_struct *mram, addr_t fpn, int swptyp, addr_t swpoff)
+{
+   if (zswap_load(mram, fpn, swptyp, swpoff) == 0)
+      return 0;
+
+   return MEMPHY_submit(swap_device(swptyp), swpoff, mram, fpn, 0);
+}
+
+/*
+ * swap_unplug - serve the queued requests of every swap device
+ */
+void swap_unplug(void)
+{
+   int i;
+
+   for (i = 0; i < swap_nr; i++)
+      if (swap_devs[i] != NULL)
+         MEMPHY_unplug(swap_devs[i]);
+}
+
+/*
+ * swap_report - print the costs of the sequential swap devices
+ */
+void swap_report(void)
+{
+   char label[16];
+   int i;
+
+   for (i = 0; i < swap_nr; i++)
+      if (swap_devs[i] != NULL && !swap_devs[i]->rdmflg)
+      {
+         snprintf(label, sizeof(label), "Swap %d", i);
+         MEMPHY_ioreport(swap_devs[i], label);
+      }
+}
+
+/*
+ * swap_cache_init - size the swap cache to the RAM frames
+ */
+int swap_cache_init(struct memphy_struct *mram)
+{
+   addr_t i;
+
+   swap_cache_mram = mram;
+   swap_cache_nr = mram->maxsz / PAGING64_PAGESZ;
+   swap_cache_typ = malloc(swap_cache_nr * sizeof(int));
+   swap_cache_off = malloc(swap_cache_nr * sizeof(addr_t));
+   for (i = 0; i < swap_cache_nr; i++)
+      swap_cache_typ[i] = -1;
+
+   return 0;
+}
+
+/* __swap_cache_forget - unlink the slot of a frame, the caller puts it */
+static int __swap_cache_forget(addr_t fpn, int *swptyp, addr_t *swpoff)
+{
+   if (fpn >= swap_cache_nr || swap_cache_typ[fpn] < 0)
+      return -1;
+
+   *swptyp = swap_cache_typ[fpn];
+   *swpoff = swap_cache_off[fpn];
+   swap_cache_typ[fpn] = -1;
+   return 0;
+}
+
+/*
+ * swap_cache_add - remember the slot a RAM frame was just read from
+ * The cache takes over the reference of the PTE that named the slot.
+ */
+int swap_cache_add(addr_t fpn, int swptyp, addr_t swpoff)
+{
+   int oldtyp;
+   addr_t oldoff;
+   int ret;
+
+   pthread_mutex_lock(&swap_cache_lock);
+   if (fpn >= swap_cache_nr)
+   {
+      pthread_mutex_unlock(&swap_cache_lock);
+      return swap_put_slot(swptyp, swpoff);
+   }
+
+   ret = __swap_cache_forget(fpn, &oldtyp, &oldoff);
+   swap_cache_typ[fpn] = swptyp;
+   swap_cache_off[fpn] = swpoff;
+   pthread_mutex_unlock(&swap_cache_lock);
+
+   if (ret == 0)
+      swap_put_slot(oldtyp, oldoff);
+   return 0;
+}
+
+/*
+ * swap_cache_get - slot still holding the contents of a RAM frame
+ * The caller gets its own reference on the slot.
+ * Returns -1 if the frame has no swap copy.
+ */
+int swap_cache_get(addr_t fpn, int *swptyp, addr_t *swpoff)
+{
+   pthread_mutex_lock(&swap_cache_lock);
+   if (fpn >= swap_cache_nr || swap_cache_typ[fpn] < 0)
+   {
+      pthread_mutex_unlock(&swap_cache_lock);
+      return -1;
+   }
+
+   *swptyp = swap_cache_typ[fpn];
+   *swpoff = swap_cache_off[fpn];
+   swap_ref_slot(*swptyp, *swpoff);
+   pthread_mutex_unlock(&swap_cache_lock);
+
+   return 0;
+}
+
+/*
+ * swap_cache_drop - forget the swap copy of a frame about to change
+ */
+void swap_cache_drop(addr_t fpn)
+{
+   int swptyp;
+   addr_t swpoff;
+   int ret;
+
+   pthread_mutex_lock(&swap_cache_lock);
+   ret = __swap_cache_forget(fpn, &swptyp, &swpoff);
+   pthread_mutex_unlock(&swap_cache_lock);
+
+   if (ret == 0)
+      swap_put_slot(swptyp, swpoff);
+}
+
+/*
+ * swap_cache_shrink - give back the slots of all cached frames
+ * Their pages get written again when evicted.  Returns the number of
+ * slots released.
+ */
+int swap_cache_shrink(void)
+{
+   int swptyp, nr = 0;
+   addr_t fpn, swpoff;
+
+   pthread_mutex_lock(&swap_cache_lock);
+   for (fpn = 0; fpn < swap_cache_nr; fpn++)
+      if (__swap_cache_forget(fpn, &swptyp, &swpoff) == 0)
+      {
+         swap_put_slot(swptyp, swpoff);
+         nr++;
+      }
+   pthread_mutex_unlock(&swap_cache_lock);
+
+   return nr;
+}
+
+/*
+ * swap_free_frame - drop a reference on a RAM frame
+ * The swap copy of the frame goes with its last user.  Freeing and
+ * forgetting happen under the cache lock, so a new owner of the frame
+ * cannot have cached a slot in between.
+ */
+int swap_free_frame(struct memphy_struct *mram, addr_t fpn)
+{
+   int swptyp = -1;
+   addr_t swpoff = 0;
+   int freed;
+
+   pthread_mutex_lock(&swap_cache_lock);
+   freed = MEMPHY_put_freefp(mram, fpn);
+   if (freed == 1 && mram == swap_cache_mram)
+      __swap_cache_forget(fpn, &swptyp, &swpoff);
+   pthread_mutex_unlock(&swap_cache_lock);
+
+   if (swptyp >= 0)
+      swap_put_slot(swptyp, swpoff);
+   return freed;
+}
+
+//#endif
@@ -24,6 +24,113 @@
 /* Macro to check overlap of two ranges */
 #define OVERLAP(s1, e1, s2, e2) ((s1 < e2) && (s2 < e1))
 
+/*
+ * Areas: mm->mmap links them in address order while vma_byaddr and
+ * vma_byid keep them sorted by start and by id, so lookups and overlap
+ * checks are binary searches.  Areas never overlap, their ends are
+ * sorted along with their starts.
+ */
+
+/* __vma_nr_upto - number of areas starting at or below addr */
+static int __vma_nr_upto(struct mm_struct *mm, addr_t addr)
+{
+  int lo = 0, hi = mm->vma_cnt, mid;
+
+  while (lo < hi)
+  {
+    mid = lo + (hi - lo) / 2;
+    if (mm->vma_byaddr[mid]->vm_start <= addr)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return lo;
+}
+
+/* __vma_id_index - first slot of vma_byid with an id not below vmaid */
+static int __vma_id_index(struct mm_struct *mm, unsigned long vmaid)
+{
+  int lo = 0, hi = mm->vma_cnt, mid;
+
+  while (lo < hi)
+  {
+    mid = lo + (hi - lo) / 2;
+    if (mm->vma_byid[mid]->vm_id < vmaid)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return lo;
+}
+
+/* __vma_overlap - does [start,end) hit an area other than skip */
+static int __vma_overlap(struct mm_struct *mm, struct vm_area_struct *skip,
+                         addr_t start, addr_t end)
+{
+  int i = __vma_nr_upto(mm, end - 1) - 1;
+
+  /* The last area starting inside or below the range ends the latest */
+  if (i >= 0 && mm->vma_byaddr[i] == skip)
+    i--;
+
+  return i >= 0 && OVERLAP(start, end, mm->vma_byaddr[i]->vm_start,
+                           mm->vma_byaddr[i]->vm_end);
+}
+
+/* __vma_addr_index - slot of an area in vma_byaddr */
+static int __vma_addr_index(struct mm_struct *mm, struct vm_area_struct *vma)
+{
+  int i = __vma_nr_upto(mm, vma->vm_start) - 1;
+
+  while (mm->vma_byaddr[i] != vma)
+    i--;
+
+  return i;
+}
+
+static int __vma_insert(struct mm_struct *mm, struct vm_area_struct *vma)
+{
+  struct vm_area_struct **arr;
+  int i, cap;
+
+  if (mm->vma_cnt == mm->vma_cap)
+  {
+    cap = mm->vma_cap * 2;
+    if ((arr = realloc(mm->vma_byaddr, cap * sizeof(*arr))) == NULL)
+      return -1;
+    mm->vma_byaddr = arr;
+    if ((arr = realloc(mm->vma_byid, cap * sizeof(*arr))) == NULL)
+      return -1;
+    mm->vma_byid = arr;
+    mm->vma_cap = cap;
+  }
+
+  /* Empty areas go before a non empty one sharing their start */
+  i = __vma_nr_upto(mm, vma->vm_start);
+  while (i > 0 && mm->vma_byaddr[i - 1]->vm_start == vma->vm_start &&
+         mm->vma_byaddr[i - 1]->vm_end > vma->vm_end)
+    i--;
+  memmove(&mm->vma_byaddr[i + 1], &mm->vma_byaddr[i],
+          (mm->vma_cnt - i) * sizeof(struct vm_area_struct *));
+  mm->vma_byaddr[i] = vma;
+
+  vma->vm_next = (i < mm->vma_cnt) ? mm->vma_byaddr[i + 1] : NULL;
+  if (i > 0)
+    mm->vma_byaddr[i - 1]->vm_next = vma;
+  else
+    mm->mmap = vma;
+
+  i = __vma_id_index(mm, vma->vm_id);
+  memmove(&mm->vma_byid[i + 1], &mm->vma_byid[i],
+          (mm->vma_cnt - i) * sizeof(struct vm_area_struct *));
+  mm->vma_byid[i] = vma;
+
+  mm->vma_cnt++;
+  return 0;
+}
+
 /*get_vma_by_num - get vm area by numID
  *@mm: memory region
  *@vmaid: ID vm area to alloc memory region
@@ -31,23 +138,373 @@
  */
 struct vm_area_struct *get_vma_by_num(struct mm_struct *mm, int vmaid)
 {
-  struct vm_area_struct *pvma = mm->mmap;
+  int i;
 
-  if (mm->mmap == NULL)
+  if (vmaid < 0)
     return NULL;
 
-  int vmait = pvma->vm_id;
+  i = __vma_id_index(mm, vmaid);
+  if (i == mm->vma_cnt || mm->vma_byid[i]->vm_id != (unsigned long)vmaid)
+    return NULL;
 
-  while (vmait < vmaid)
+  return mm->vma_byid[i];
+}
+
+/*get_vma_by_addr - get the vm area covering an address
+ *@mm: memory region
+ *@addr: virtual address
+ *
+ */
+struct vm_area_struct *get_vma_by_addr(struct mm_struct *mm, addr_t addr)
+{
+  int i = __vma_nr_upto(mm, addr) - 1;
+
+  if (i < 0 || addr >= mm->vma_byaddr[i]->vm_end)
+    return NULL;
+
+  return mm->vma_byaddr[i];
+}
+
+/*vm_area_create - add an area to an address space
+ *@mm: memory region
+ *@start: first address
+ *@end: first address past the area
+ *@flags: VM_* flags
+ *
+ * The area takes the next id, NULL if it would overlap another one.
+ */
+struct vm_area_struct *vm_area_create(struct mm_struct *mm, addr_t start,
+                                      addr_t end, unsigned long flags)
+{
+  struct vm_area_struct *vma;
+
+  if (start > end || (start < end && __vma_overlap(mm, NULL, start, end)))
+    return NULL;
+
+  vma = malloc(sizeof(struct vm_area_struct));
+  vma->vm_id = mm->vma_next_id;
+  vma->vm_start = start;
+  vma->vm_end = end;
+  vma->vm_flags = flags;
+  vma->sbrk = (flags & VM_GROWSDOWN) ? start : end;
+  vma->vm_mm = mm;
+  vma->vm_shm = NULL;
+  vma->vm_file = NULL;
+  vm_freerg_init(vma);
+
+  if (__vma_insert(mm, vma) != 0)
+  {
+    free(vma);
+    return NULL;
+  }
+  mm->vma_next_id++;
+
+  return vma;
+}
+
+/*vm_area_unlink - take an area out of its space and free it
+ *@mm: memory region
+ *@vma: vm area, its pages must be unmapped already
+ */
+void vm_area_unlink(struct mm_struct *mm, struct vm_area_struct *vma)
+{
+  int i = __vma_addr_index(mm, vma);
+
+  if (i > 0)
+    mm->vma_byaddr[i - 1]->vm_next = vma->vm_next;
+  else
+    mm->mmap = vma->vm_next;
+  memmove(&mm->vma_byaddr[i], &mm->vma_byaddr[i + 1],
+          (mm->vma_cnt - i - 1) * sizeof(struct vm_area_struct *));
+
+  i = __vma_id_index(mm, vma->vm_id);
+  memmove(&mm->vma_byid[i], &mm->vma_byid[i + 1],
+          (mm->vma_cnt - i - 1) * sizeof(struct vm_area_struct *));
+
+  mm->vma_cnt--;
+  vm_freerg_release(vma);
+  free(vma);
+}
+
+/*vm_area_init - set up the heap and stack areas of a new space
+ *@mm: memory region
+ */
+int vm_area_init(struct mm_struct *mm)
+{
+  mm->mmap = NULL;
+  mm->vma_cnt = 0;
+  mm->vma_cap = VM_AREA_INIT_CAP;
+  mm->vma_byaddr = malloc(mm->vma_cap * sizeof(struct vm_area_struct *));
+  mm->vma_byid = malloc(mm->vma_cap * sizeof(struct vm_area_struct *));
+  mm->vma_next_id = VM_HEAP_ID;
+  mm->mmap_base = VM_MMAP_BASE;
+
+  if (vm_area_create(mm, 0, 0, 0) == NULL ||
+      vm_area_create(mm, VM_STACK_TOP, VM_STACK_TOP, VM_GROWSDOWN) == NULL)
+    return -1;
+
+  return 0;
+}
+
+/*vm_area_dup - copy the areas of another space
+ *@mm: memory region, its areas fields are overwritten
+ *@src: memory region copied from
+ */
+int vm_area_dup(struct mm_struct *mm, struct mm_struct *src)
+{
+  struct vm_area_struct *vma, *prev = NULL;
+  int i;
+
+  mm->vma_byaddr = malloc(src->vma_cap * sizeof(struct vm_area_struct *));
+  mm->vma_byid = malloc(src->vma_cap * sizeof(struct vm_area_struct *));
+  mm->mmap = NULL;
+
+  /* Copies keep the order of their originals, ids do not change */
+  for (i = 0; i < src->vma_cnt; i++)
   {
-    if (pvma == NULL)
-      return NULL;
+    vma = malloc(sizeof(struct vm_area_struct));
+    memcpy(vma, src->vma_byaddr[i], sizeof(struct vm_area_struct));
+    vma->vm_mm = mm;
+    vma->vm_next = NULL;
+    vm_freerg_dup(vma, src->vma_byaddr[i]);
 
-    pvma = pvma->vm_next;
-    vmait = pvma->vm_id;
+    mm->vma_byaddr[i] = vma;
+    if (prev != NULL)
+      prev->vm_next = vma;
+    else
+      mm->mmap = vma;
+    prev = vma;
   }
 
-  return pvma;
+  for (i = 0; i < src->vma_cnt; i++)
+    mm->vma_byid[i] = mm->vma_byaddr[__vma_addr_index(src, src->vma_byid[i])];
+
+  return 0;
+}
+
+/*vm_area_release - drop all areas of a space
+ *@mm: memory region
+ */
+void vm_area_release(struct mm_struct *mm)
+{
+  struct vm_area_struct *vma;
+
+  while ((vma = mm->mmap) != NULL)
+  {
+    mm->mmap = vma->vm_next;
+    vm_freerg_release(vma);
+    free(vma);
+  }
+
+  free(mm->vma_byaddr);
+  free(mm->vma_byid);
+  mm->vma_byaddr = mm->vma_byid = NULL;
+  mm->vma_cnt = mm->vma_cap = 0;
+}
+
+/*
+ * Free regions: a region sits in the bin of its size class, so any
+ * region of a higher class fits a request and the lowest non empty one
+ * is found from the class mask.  The chains hashed by start and by end
+ * let a freed region find the free regions right next to it.
+ */
+#define VM_FREERG_HASH(addr) ((((addr) >> 4) ^ ((addr) >> 12)) % VM_FREERG_HASHSZ)
+
+/* Only this many regions of the request's own class are tried */
+#define VM_FREERG_SCAN 4
+
+static int __freerg_class(addr_t size)
+{
+  return 63 - __builtin_clzll(size);
+}
+
+static void __freerg_link(struct vm_area_struct *vma, struct vm_rg_struct *rg)
+{
+  int cls = __freerg_class(rg->rg_end - rg->rg_start);
+  struct vm_rg_struct **pbin = &vma->vm_freerg_bin[cls];
+  int hs = VM_FREERG_HASH(rg->rg_start);
+  int he = VM_FREERG_HASH(rg->rg_end);
+
+  rg->rg_prev = NULL;
+  rg->rg_next = *pbin;
+  if (*pbin != NULL)
+    (*pbin)->rg_prev = rg;
+  *pbin = rg;
+  vma->vm_freerg_mask |= BIT_ULL(cls);
+
+  rg->rg_snext = vma->vm_freerg_bystart[hs];
+  vma->vm_freerg_bystart[hs] = rg;
+  rg->rg_enext = vma->vm_freerg_byend[he];
+  vma->vm_freerg_byend[he] = rg;
+}
+
+static void __freerg_unlink(struct vm_area_struct *vma, struct vm_rg_struct *rg)
+{
+  int cls = __freerg_class(rg->rg_end - rg->rg_start);
+  struct vm_rg_struct **prg;
+
+  if (rg->rg_prev != NULL)
+    rg->rg_prev->rg_next = rg->rg_next;
+  else
+    vma->vm_freerg_bin[cls] = rg->rg_next;
+  if (rg->rg_next != NULL)
+    rg->rg_next->rg_prev = rg->rg_prev;
+  if (vma->vm_freerg_bin[cls] == NULL)
+    vma->vm_freerg_mask &= ~BIT_ULL(cls);
+
+  for (prg = &vma->vm_freerg_bystart[VM_FREERG_HASH(rg->rg_start)];
+       *prg != rg; prg = &(*prg)->rg_snext)
+    ;
+  *prg = rg->rg_snext;
+
+  for (prg = &vma->vm_freerg_byend[VM_FREERG_HASH(rg->rg_end)];
+       *prg != rg; prg = &(*prg)->rg_enext)
+    ;
+  *prg = rg->rg_enext;
+
+  rg->rg_next = rg->rg_prev = rg->rg_snext = rg->rg_enext = NULL;
+}
+
+/*vm_freerg_init - start an area without free regions
+ *@vma: vm area
+ */
+void vm_freerg_init(struct vm_area_struct *vma)
+{
+  memset(vma->vm_freerg_bin, 0, sizeof(vma->vm_freerg_bin));
+  memset(vma->vm_freerg_bystart, 0, sizeof(vma->vm_freerg_bystart));
+  memset(vma->vm_freerg_byend, 0, sizeof(vma->vm_freerg_byend));
+  memset(vma->vm_slab, 0, sizeof(vma->vm_slab));
+  vma->vm_freerg_mask = 0;
+}
+
+/*vm_freerg_put - give [start,end) back to an area
+ *@vma: vm area
+ *
+ * The region merges with the free regions ending at its start and
+ * starting at its end.
+ */
+int vm_freerg_put(struct vm_area_struct *vma, addr_t start, addr_t end)
+{
+  struct vm_rg_struct *rg;
+
+  if (start >= end)
+    return -1;
+
+  for (rg = vma->vm_freerg_byend[VM_FREERG_HASH(start)]; rg != NULL; rg = rg->rg_enext)
+    if (rg->rg_end == start)
+      break;
+  if (rg != NULL)
+  {
+    __freerg_unlink(vma, rg);
+    start = rg->rg_start;
+    free(rg);
+  }
+
+  for (rg = vma->vm_freerg_bystart[VM_FREERG_HASH(end)]; rg != NULL; rg = rg->rg_snext)
+    if (rg->rg_start == end)
+      break;
+  if (rg != NULL)
+  {
+    __freerg_unlink(vma, rg);
+    end = rg->rg_end;
+    free(rg);
+  }
+
+  __freerg_link(vma, init_vm_rg(start, end));
+  return 0;
+}
+
+/*vm_freerg_get - carve a region of size bytes out of the free regions
+ *@vma: vm area
+ *@size: region size
+ *@newrg: the carved region
+ */
+int vm_freerg_get(struct vm_area_struct *vma, addr_t size, struct vm_rg_struct *newrg)
+{
+  struct vm_rg_struct *rg;
+  uint64_t mask;
+  int cls, n;
+
+  if (size == 0)
+    return -1;
+
+  /* A few tries in the own class keep large regions whole */
+  cls = __freerg_class(size);
+  for (rg = vma->vm_freerg_bin[cls], n = 0; rg != NULL && n < VM_FREERG_SCAN;
+       rg = rg->rg_next, n++)
+    if (rg->rg_start + size <= rg->rg_end)
+      break;
+
+  if (rg == NULL || n == VM_FREERG_SCAN)
+  {
+    mask = (cls < 63) ? vma->vm_freerg_mask & ~(BIT_ULL(cls + 1) - 1) : 0;
+    if (mask == 0)
+      return -1;
+    rg = vma->vm_freerg_bin[__builtin_ctzll(mask)];
+  }
+
+  __freerg_unlink(vma, rg);
+  newrg->rg_start = rg->rg_start;
+  newrg->rg_end = rg->rg_start + size;
+
+  if (newrg->rg_end < rg->rg_end)
+  {
+    rg->rg_start = newrg->rg_end;
+    __freerg_link(vma, rg);
+  }
+  else
+    free(rg);
+
+  return 0;
+}
+
+/*vm_freerg_dup - copy the free regions and slab objects of another area
+ *@vma: vm area, its own regions are not released
+ *@src: vm area copied from
+ */
+void vm_freerg_dup(struct vm_area_struct *vma, struct vm_area_struct *src)
+{
+  struct vm_rg_struct *rg, **prg;
+  int cls;
+
+  vm_freerg_init(vma);
+  for (cls = 0; cls < VM_FREERG_NCLASS; cls++)
+    for (rg = src->vm_freerg_bin[cls]; rg != NULL; rg = rg->rg_next)
+      __freerg_link(vma, init_vm_rg(rg->rg_start, rg->rg_end));
+
+  for (cls = 0; cls < VM_SLAB_NCLASS; cls++)
+  {
+    prg = &vma->vm_slab[cls];
+    for (rg = src->vm_slab[cls]; rg != NULL; rg = rg->rg_next)
+    {
+      *prg = init_vm_rg(rg->rg_start, rg->rg_end);
+      prg = &(*prg)->rg_next;
+    }
+  }
+}
+
+/*vm_freerg_release - drop all free regions and slab objects of an area
+ *@vma: vm area
+ */
+void vm_freerg_release(struct vm_area_struct *vma)
+{
+  struct vm_rg_struct *rg;
+  int cls;
+
+  for (cls = 0; cls < VM_FREERG_NCLASS; cls++)
+    while ((rg = vma->vm_freerg_bin[cls]) != NULL)
+    {
+      vma->vm_freerg_bin[cls] = rg->rg_next;
+      free(rg);
+    }
+
+  for (cls = 0; cls < VM_SLAB_NCLASS; cls++)
+    while ((rg = vma->vm_slab[cls]) != NULL)
+    {
+      vma->vm_slab[cls] = rg->rg_next;
+      free(rg);
+    }
+  vm_freerg_init(vma);
 }
 
 int __mm_swap_page(struct pcb_t *caller, addr_t vicfpn , addr_t swpfpn)
@@ -94,38 +551,14 @@ struct vm_rg_struct *get_vm_area_node_at_brk(struct pcb_t *caller, int vmaid, ad
  */
 int validate_overlap_vm_area(struct pcb_t *caller, int vmaid, addr_t vmastart, addr_t vmaend)
 {
-  /* TODO validate the planned memory area is not overlapped */
-  if (vmastart >= vmaend)
-  {
-    return -1; // Invalid range
-  }
-
- struct vm_area_struct *vma = caller->mm->mmap;
-  if (vma == NULL)
-  {
-    return 0; // No VMAs to overlap with (though unusual if caller exists)
-  }
+  struct vm_area_struct *cur_area = get_vma_by_num(caller->mm, vmaid);
 
-struct vm_area_struct *cur_area = get_vma_by_num(caller->mm, vmaid);  
-if (cur_area == NULL)
-  {
+  if (vmastart >= vmaend || cur_area == NULL)
     return -1;
-  }
 
-  /* Iterate through all VM areas to check for overlap */
-  while (vma != NULL)
-  {
-    // Skip the current area being extended (we only care if it hits OTHERS)
-    if (vma != cur_area) 
-    {
-        // Check intersection: [vmastart, vmaend) vs [vma->vm_start, vma->vm_end)
-        if (OVERLAP(vmastart, vmaend, vma->vm_start, vma->vm_end))
-        {
-            return -1; // Overlap detected
-        }
-    }
-    vma = vma->vm_next;
-  }
+  /* Only other areas matter, the current one is being extended */
+  if (__vma_overlap(caller->mm, cur_area, vmastart, vmaend))
+    return -1;
 
   return 0;
 }
@@ -135,56 +568,114 @@ if (cur_area == NULL)
  *@vmaid: ID vm area to alloc memory region
  *@inc_sz: increment size
  *
+ * Areas growing down move their start (and sbrk with it) below the
+ * old one, the others move their end.
  */
-/* src/mm-vm.c */
-/* ... include giữ nguyên ... */
-
 int inc_vma_limit(struct pcb_t *caller, int vmaid, addr_t inc_sz)
 {
-  struct vm_rg_struct * newrg = malloc(sizeof(struct vm_rg_struct));
-  int inc_amt;
-  int incnumpage;
-  /* FIX: Dùng caller->mm */
+  struct vm_rg_struct newrg;
   struct vm_area_struct *cur_vma = get_vma_by_num(caller->mm, vmaid);
-  int old_end;
-
-  if (cur_vma == NULL) {
-      free(newrg);
-      return -1;
-  }
+  addr_t inc_amt = inc_sz;
+  addr_t start, end;
+  int incnumpage;
 
-  old_end = cur_vma->vm_end;
+  if (cur_vma == NULL)
+    return -1;
 
 #ifdef MM64
-  /* Logic 64-bit: inc_sz đã là số bytes (được tính ở libmem) */
-  inc_amt = inc_sz;
   incnumpage = inc_amt / PAGING64_PAGESZ;
 #else
-  /* Logic cũ */
-  inc_amt = inc_sz;
   incnumpage = inc_amt / PAGING_PAGESZ;
 #endif
 
-  /* Validate overlap */
-  if (validate_overlap_vm_area(caller, vmaid, old_end, old_end + inc_amt) < 0)
+  if (cur_vma->vm_flags & VM_GROWSDOWN)
+  {
+    if (inc_amt > cur_vma->vm_start)
+      return -1;
+    start = cur_vma->vm_start - inc_amt;
+    end = cur_vma->vm_start;
+  }
+  else
   {
-    free(newrg);
-    return -1; 
+    start = cur_vma->vm_end;
+    end = cur_vma->vm_end + inc_amt;
   }
 
-  /* Map memory */
-  if (vm_map_ram(caller, cur_vma->vm_start, cur_vma->vm_end + inc_amt, 
-                 old_end, incnumpage, newrg) < 0)
+  if (validate_overlap_vm_area(caller, vmaid, start, end) < 0)
+    return -1;
+
+  if (vm_map_ram(caller, start, end, start, incnumpage, &newrg) < 0)
+    return -1;
+
+  if (cur_vma->vm_flags & VM_GROWSDOWN)
   {
-    free(newrg);
-    return -1; 
+    cur_vma->vm_start = start;
+    cur_vma->sbrk = start;
   }
+  else
+  {
+    cur_vma->vm_end = end;
+    cur_vma->sbrk += inc_amt;
+  }
+
+  return 0;
+}
+
+/*vm_mmap_anon - map an anonymous area of len bytes
+ *@caller: caller
+ *@len: area size, rounded up to pages
+ *@rgid: region handle bound to the whole area
+ *@addr: start of the area
+ *
+ * Areas are placed downwards from VM_MMAP_BASE.  Returns the id of the
+ * area.
+ */
+int vm_mmap_anon(struct pcb_t *caller, addr_t len, int rgid, addr_t *addr)
+{
+  struct mm_struct *mm = caller->mm;
+  struct vm_area_struct *vma;
+
+  len = PAGING64_PAGE_ALIGNSZ(len);
+  if (len == 0 || len > mm->mmap_base)
+    return -1;
+
+  /* Pages are demand zero, they fault in on touch */
+  vma = vm_area_create(mm, mm->mmap_base - len, mm->mmap_base, 0);
+  if (vma == NULL)
+    return -1;
 
-  cur_vma->vm_end += inc_amt;
-  cur_vma->sbrk += inc_amt; // Cập nhật sbrk
+  if (symrg_bind(mm, rgid, vma->vm_start, vma->vm_end) != 0)
+  {
+    vm_area_unlink(mm, vma);
+    return -1;
+  }
+
+  mm->mmap_base = vma->vm_start;
+  *addr = vma->vm_start;
+
+  return vma->vm_id;
+}
+
+/*vm_stack_push - grow the stack by len bytes and bind them to a handle
+ *@caller: caller
+ *@len: size, rounded up to pages
+ *@rgid: region handle bound to the new bottom of the stack
+ *@addr: start of the new part
+ */
+int vm_stack_push(struct pcb_t *caller, addr_t len, int rgid, addr_t *addr)
+{
+  struct vm_area_struct *vma;
+
+  len = PAGING64_PAGE_ALIGNSZ(len);
+  if (len == 0 || inc_vma_limit(caller, VM_STACK_ID, len) != 0)
+    return -1;
+
+  vma = get_vma_by_num(caller->mm, VM_STACK_ID);
+  if (symrg_bind(caller->mm, rgid, vma->vm_start, vma->vm_start + len) != 0)
+    return -1;
 
-  free(newrg);
+  *addr = vma->vm_start;
   return 0;
 }
 
-// #endif
\ No newline at end of file
+// #endif
@@ -0,0 +1,374 @@
+/*
+ * Copyright (C) 2026 pdnguyen of HCMC University of Technology VNU-HCM
+ */
+
+/* LamiaAtrium release
+ * Source Code License Grant: The authors hereby grant to Licensee
+ * personal permission to use and modify the Licensed Source Code
+ * for the sole purpose of studying while attending the course CO2018.
+ */
+
+//#ifdef MM_PAGING
+/*
+ * PAGING based Memory Management
+ * Compressed swap cache mm/mm-zswap.c
+ *
+ * Pages on their way out to a swap slot are kept compressed in a
+ * bounded pool instead, keyed by the slot.  Same-filled pages only keep
+ * their fill byte, pages that do not shrink enough go to the device.
+ * Once the pool is full its oldest entries are written back to their
+ * slot on the device.
+ *
+ * The pool lives in host memory, it is not carved out of RAM frames.
+ * It is bounded at ZSWAP_POOL_PCT of RAM instead, and every entry is
+ * charged its header on top of its data so same-filled pages count too.
+ */
+
+#include "mm.h"
+#include "mm64.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#define ZSWAP_HASH_SZ 1024
+
+/* LZ codec: a control byte below 0x80 starts a run of (c + 1) literals,
+ * above it a match of (c & 0x7f) + 3 bytes at a 16 bit back offset */
+#define ZSWAP_LZ_HTAB_SZ 4096
+#define ZSWAP_LZ_MINMATCH 3
+#define ZSWAP_LZ_MAXMATCH (0x7f + ZSWAP_LZ_MINMATCH)
+#define ZSWAP_LZ_MAXLIT 0x80
+
+/* Only keep pages compressed to at most 3/4 of their size */
+#define ZSWAP_MAX_CLEN (PAGING64_PAGESZ * 3 / 4)
+
+struct zswap_entry {
+   int swptyp;
+   addr_t swpoff;
+   int len;   /* compressed length, 0 for a same-filled page */
+   BYTE fill;
+   BYTE *data;
+   struct zswap_entry *prev, *next; /* pool order, newest first */
+   struct zswap_entry *hnext;
+};
+
+/* Pool bytes an entry holding @len compressed bytes costs */
+#define ZSWAP_ENTRY_COST(len) ((long)sizeof(struct zswap_entry) + (len))
+
+static struct zswap_entry *zswap_hash[ZSWAP_HASH_SZ];
+static struct zswap_entry *zswap_newest, *zswap_oldest;
+static long zswap_pool_sz;
+static long zswap_pool_max;
+static int zswap_enabled;
+static pthread_mutex_t zswap_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct {
+   unsigned long stored;
+   unsigned long same_filled;
+   unsigned long rejected;
+   unsigned long written_back;
+   unsigned long loaded;
+} zswap_stat;
+
+static int __lz_literals(const BYTE *src, int from, int to,
+                         BYTE *dst, int op, int cap)
+{
+   int n;
+
+   while (from < to)
+   {
+      n = to - from;
+      if (n > ZSWAP_LZ_MAXLIT)
+         n = ZSWAP_LZ_MAXLIT;
+      if (op + 1 + n > cap)
+         return -1;
+
+      dst[op++] = n - 1;
+      memcpy(dst + op, src + from, n);
+      op += n;
+      from += n;
+   }
+
+   return op;
+}
+
+/*
+ * zswap_compress - greedy LZ77 over a 3 byte hash
+ * Returns the compressed length, -1 if it does not fit in @cap.
+ */
+static int zswap_compress(const BYTE *src, int len, BYTE *dst, int cap)
+{
+   const uint8_t *u = (const uint8_t *)src; /* BYTE is a signed char */
+   int htab[ZSWAP_LZ_HTAB_SZ];
+   int ip = 0, anchor = 0, op = 0;
+   int h, ref, mlen;
+
+   for (h = 0; h < ZSWAP_LZ_HTAB_SZ; h++)
+      htab[h] = -1;
+
+   while (ip + ZSWAP_LZ_MINMATCH <= len)
+   {
+      h = ((u[ip] << 8) ^ (u[ip + 1] << 4) ^ u[ip + 2]) &
+          (ZSWAP_LZ_HTAB_SZ - 1);
+      ref = htab[h];
+      htab[h] = ip;
+
+      if (ref < 0 || ip - ref > 0xffff ||
+          memcmp(src + ref, src + ip, ZSWAP_LZ_MINMATCH) != 0)
+      {
+         ip++;
+         continue;
+      }
+
+      /* Matches may overlap the bytes they produce, runs come out cheap */
+      mlen = ZSWAP_LZ_MINMATCH;
+      while (ip + mlen < len && mlen < ZSWAP_LZ_MAXMATCH &&
+             src[ref + mlen] == src[ip + mlen])
+         mlen++;
+
+      op = __lz_literals(src, anchor, ip, dst, op, cap);
+      if (op < 0 || op + 3 > cap)
+         return -1;
+
+      dst[op++] = 0x80 | (mlen - ZSWAP_LZ_MINMATCH);
+      dst[op++] = (ip - ref) & 0xff;
+      dst[op++] = (ip - ref) >> 8;
+      ip += mlen;
+      anchor = ip;
+   }
+
+   return __lz_literals(src, anchor, len, dst, op, cap);
+}
+
+static int zswap_decompress(const BYTE *src, int slen, BYTE *dst, int cap)
+{
+   const uint8_t *u = (const uint8_t *)src;
+   int ip = 0, op = 0;
+   int n, off;
+   uint8_t c;
+
+   while (ip < slen)
+   {
+      c = u[ip++];
+      if (c & 0x80)
+      {
+         if (ip + 2 > slen)
+            return -1;
+         n = (c & 0x7f) + ZSWAP_LZ_MINMATCH;
+         off = u[ip] | (u[ip + 1] << 8);
+         ip += 2;
+         if (off <= 0 || off > op || op + n > cap)
+            return -1;
+         while (n-- > 0)
+         {
+            dst[op] = dst[op - off];
+            op++;
+         }
+      }
+      else
+      {
+         n = c + 1;
+         if (ip + n > slen || op + n > cap)
+            return -1;
+         memcpy(dst + op, src + ip, n);
+         ip += n;
+         op += n;
+      }
+   }
+
+   return op;
+}
+
+static void __entry_expand(struct zswap_entry *e, BYTE *buf)
+{
+   if (e->len == 0)
+      memset(buf, e->fill, PAGING64_PAGESZ);
+   else
+      zswap_decompress(e->data, e->len, buf, PAGING64_PAGESZ);
+}
+
+static struct zswap_entry **__entry_slot(int swptyp, addr_t swpoff)
+{
+   struct zswap_entry **pe;
+
+   pe = &zswap_hash[(swpoff * PAGING_MAX_MMSWP + swptyp) % ZSWAP_HASH_SZ];
+   while (*pe != NULL && ((*pe)->swptyp != swptyp || (*pe)->swpoff != swpoff))
+      pe = &(*pe)->hnext;
+
+   return pe;
+}
+
+/* __entry_drop - unlink an entry from the pool and free it */
+static void __entry_drop(struct zswap_entry **pe)
+{
+   struct zswap_entry *e = *pe;
+
+   *pe = e->hnext;
+
+   if (e->prev) e->prev->next = e->next;
+   else zswap_newest = e->next;
+   if (e->next) e->next->prev = e->prev;
+   else zswap_oldest = e->prev;
+
+   zswap_pool_sz -= ZSWAP_ENTRY_COST(e->len);
+   free(e->data);
+   free(e);
+}
+
+/* __pool_shrink - write the oldest entries back until @need bytes fit */
+static void __pool_shrink(long need)
+{
+   BYTE buf[PAGING64_PAGESZ];
+   struct zswap_entry *e;
+
+   while (zswap_oldest != NULL && zswap_pool_sz + need > zswap_pool_max)
+   {
+      e = zswap_oldest;
+      __entry_expand(e, buf);
+      MEMPHY_write_page(swap_device(e->swptyp), e->swpoff, buf);
+      zswap_stat.written_back++;
+      __entry_drop(__entry_slot(e->swptyp, e->swpoff));
+   }
+}
+
+/*
+ * zswap_init - size the pool from the RAM it lives in
+ */
+int zswap_init(struct memphy_struct *mram)
+{
+   zswap_pool_max = (long)mram->maxsz * ZSWAP_POOL_PCT / 100;
+   zswap_enabled = (zswap_pool_max >= ZSWAP_ENTRY_COST(0));
+   return 0;
+}
+
+/*
+ * zswap_store - keep a RAM frame compressed for a swap slot
+ * Returns 0 if the pool took it, -1 if it has to go to the device.
+ */
+int zswap_store(struct memphy_struct *mram, addr_t fpn, int swptyp, addr_t swpoff)
+{
+   BYTE page[PAGING64_PAGESZ];
+   BYTE cbuf[ZSWAP_MAX_CLEN];
+   struct zswap_entry *e;
+   struct zswap_entry **pe;
+   int i, len;
+
+   pthread_mutex_lock(&zswap_lock);
+
+   /* A reused slot must never read back what it held before */
+   pe = __entry_slot(swptyp, swpoff);
+   if (*pe != NULL)
+      __entry_drop(pe);
+
+   if (!zswap_enabled)
+   {
+      pthread_mutex_unlock(&zswap_lock);
+      return -1;
+   }
+
+   MEMPHY_read_page(mram, fpn, page);
+
+   for (i = 1; i < PAGING64_PAGESZ && page[i] == page[0]; i++)
+      ;
+   if (i == PAGING64_PAGESZ)
+      len = 0;
+   else if ((len = zswap_compress(page, PAGING64_PAGESZ, cbuf, sizeof(cbuf))) < 0)
+   {
+      zswap_stat.rejected++;
+      pthread_mutex_unlock(&zswap_lock);
+      return -1;
+   }
+
+   if (ZSWAP_ENTRY_COST(len) > zswap_pool_max)
+   {
+      zswap_stat.rejected++;
+      pthread_mutex_unlock(&zswap_lock);
+      return -1;
+   }
+   __pool_shrink(ZSWAP_ENTRY_COST(len));
+
+   e = malloc(sizeof(struct zswap_entry));
+   e->swptyp = swptyp;
+   e->swpoff = swpoff;
+   e->len = len;
+   e->fill = page[0];
+   e->data = NULL;
+   if (len > 0)
+   {
+      e->data = malloc(len);
+      memcpy(e->data, cbuf, len);
+   }
+
+   e->prev = NULL;
+   e->next = zswap_newest;
+   if (e->next) e->next->prev = e;
+   else zswap_oldest = e;
+   zswap_newest = e;
+
+   pe = __entry_slot(swptyp, swpoff);
+   e->hnext = NULL;
+   *pe = e;
+
+   zswap_pool_sz += ZSWAP_ENTRY_COST(len);
+   if (len == 0)
+      zswap_stat.same_filled++;
+   else
+      zswap_stat.stored++;
+
+   pthread_mutex_unlock(&zswap_lock);
+   return 0;
+}
+
+/*
+ * zswap_load - fill a RAM frame from the pool
+ * The entry stays, other page tables may share the slot.
+ * Returns -1 if the slot is not in the pool.
+ */
+int zswap_load(struct memphy_struct *mram, addr_t fpn, int swptyp, addr_t swpoff)
+{
+   BYTE page[PAGING64_PAGESZ];
+   struct zswap_entry *e;
+
+   pthread_mutex_lock(&zswap_lock);
+   e = *__entry_slot(swptyp, swpoff);
+   if (e == NULL)
+   {
+      pthread_mutex_unlock(&zswap_lock);
+      return -1;
+   }
+
+   __entry_expand(e, page);
+   zswap_stat.loaded++;
+   pthread_mutex_unlock(&zswap_lock);
+
+   MEMPHY_write_page(mram, fpn, page);
+   return 0;
+}
+
+/*
+ * zswap_invalidate - forget a freed swap slot
+ */
+void zswap_invalidate(int swptyp, addr_t swpoff)
+{
+   struct zswap_entry **pe;
+
+   pthread_mutex_lock(&zswap_lock);
+   pe = __entry_slot(swptyp, swpoff);
+   if (*pe != NULL)
+      __entry_drop(pe);
+   pthread_mutex_unlock(&zswap_lock);
+}
+
+void zswap_report(void)
+{
+   pthread_mutex_lock(&zswap_lock);
+   printf("Zswap: stored %lu same-filled %lu rejected %lu written back %lu "
+          "loaded %lu pool %ld/%ld bytes\n",
+          zswap_stat.stored, zswap_stat.same_filled, zswap_stat.rejected,
+          zswap_stat.written_back, zswap_stat.loaded,
+          zswap_pool_sz, zswap_pool_max);
+   pthread_mutex_unlock(&zswap_lock);
+}
+
+//#endif
@@ -26,7 +26,7 @@
 /*
  * init_pte - Initialize PTE entry
  */
-int init_pte(addr_t *pte,
+int init_pte(pte_t *pte,
              int pre,    // present
              addr_t fpn,    // FPN
              int drt,    // dirty
@@ -134,7 +134,7 @@ int pte_set_fpn(struct pcb_t *caller, addr_t pgn, addr_t fpn)
  * @pgn    : page number
  * @ret    : page table entry
  **/
-uint32_t pte_get_entry(struct pcb_t *caller, addr_t pgn)
+pte_t pte_get_entry(struct pcb_t *caller, addr_t pgn)
 {
   printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
   return 0;
@@ -145,7 +145,7 @@ uint32_t pte_get_entry(struct pcb_t *caller, addr_t pgn)
  * @pgn    : page number
  * @ret    : page table entry
  **/
-int pte_set_entry(struct pcb_t *caller, addr_t pgn, uint32_t pte_val)
+int pte_set_entry(struct pcb_t *caller, addr_t pgn, pte_t pte_val)
 {
 	struct krnl_t *krnl = caller->krnl;
 	krnl->mm->pgd[pgn]=pte_val;
@@ -153,6 +153,24 @@ int pte_set_entry(struct pcb_t *caller, addr_t pgn, uint32_t pte_val)
 	return 0;
 }
 
+int pte_mkyoung(struct mm_struct *mm, addr_t pgn)
+{
+  printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
+  return 0;
+}
+
+int pte_test_and_clear_young(struct mm_struct *mm, addr_t pgn)
+{
+  printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
+  return 0;
+}
+
+int pte_mkdirty(struct mm_struct *mm, addr_t pgn)
+{
+  printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
+  return 0;
+}
+
 /*
  * vmap_pgd_memset - map a range of page at aligned address
  */
@@ -170,7 +188,7 @@ int vmap_pgd_memset(struct pcb_t *caller,           // process call
 addr_t vmap_page_range(struct pcb_t *caller,           // process call
                     addr_t addr,                       // start address which is aligned to pagesz
                     int pgnum,                      // num of mapping page
-                    struct framephy_struct *frames, // list of the mapped frames
+                    addr_t *frames,                 // the mapped frames
                     struct vm_rg_struct *ret_rg)    // return mapped region, the real mapped fp
 {                                                   // no guarantee all given pages are mapped
   printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
@@ -181,10 +199,10 @@ addr_t vmap_page_range(struct pcb_t *caller,           // process call
  * alloc_pages_range - allocate req_pgnum of frame in ram
  * @caller    : caller
  * @req_pgnum : request page num
- * @frm_lst   : frame list
+ * @frames    : allocated frames
  */
 
-addr_t alloc_pages_range(struct pcb_t *caller, int req_pgnum, struct framephy_struct **frm_lst)
+addr_t alloc_pages_range(struct pcb_t *caller, int req_pgnum, addr_t *frames)
 {
   printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
   return 0;
@@ -205,6 +223,17 @@ addr_t vm_map_ram(struct pcb_t *caller, addr_t astart, addr_t aend, addr_t mapst
   return 0;
 }
 
+/*
+ * vmap_huge_page - map a huge page at aligned address
+ * @caller    : caller
+ * @addr      : start address which is aligned to the huge page size
+ */
+int vmap_huge_page(struct pcb_t *caller, addr_t addr)
+{
+  printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
+  return -1;
+}
+
 /* Swap copy content page from source frame to destination frame
  * @mpsrc  : source memphy
  * @srcfpn : source physical page number (FPN)
@@ -229,6 +258,27 @@ int init_mm(struct mm_struct *mm, struct pcb_t *caller)
   return 0;
 }
 
+/*
+ * dup_mm - clone the address space of a process into its child
+ * @caller: parent process
+ * @child : child process
+ */
+int dup_mm(struct pcb_t *caller, struct pcb_t *child)
+{
+  printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
+  return -1;
+}
+
+/*
+ * free_mm - tear down the address space of an exiting process
+ * @caller: exiting process
+ */
+int free_mm(struct pcb_t *caller)
+{
+  printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
+  return -1;
+}
+
 struct vm_rg_struct *init_vm_rg(addr_t rg_start, addr_t rg_end)
 {
   printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
@@ -17,14 +17,17 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <time.h>
+#include <pthread.h>
 #include <string.h> /* QUAN TRỌNG: Để dùng memset */
 
 #if defined(MM64)
 
 /*
  * init_pte - Initialize PTE entry
+ * The entry is built from scratch: a swapped page is not present and
+ * carries its swap location, an online page carries its frame number.
  */
-int init_pte(addr_t *pte,
+int init_pte(pte_t *pte,
              int pre,    // present
              addr_t fpn,    // FPN
              int drt,    // dirty
@@ -32,29 +35,26 @@ int init_pte(addr_t *pte,
              int swptyp, // swap type
              addr_t swpoff) // swap offset
 {
-  if (pre != 0) {
-    if (swp == 0) { // Non swap ~ page online
-      if (fpn == 0)
-        return -1;  // Invalid setting
+  *pte = 0;
 
-      /* Valid setting with FPN */
-      SETBIT(*pte, PAGING_PTE_PRESENT_MASK);
-      CLRBIT(*pte, PAGING_PTE_SWAPPED_MASK);
-      CLRBIT(*pte, PAGING_PTE_DIRTY_MASK);
+  if (swp != 0) { // page swapped
+    SETBIT(*pte, PAGING_PTE_SWAPPED_MASK);
 
-      SETVAL(*pte, fpn, PAGING_PTE_FPN_MASK, PAGING_PTE_FPN_LOBIT);
-    }
-    else
-    { // page swapped
-      SETBIT(*pte, PAGING_PTE_PRESENT_MASK);
-      SETBIT(*pte, PAGING_PTE_SWAPPED_MASK);
-      CLRBIT(*pte, PAGING_PTE_DIRTY_MASK);
+    SETVAL(*pte, (pte_t)swptyp, PAGING_PTE_SWPTYP_MASK, PAGING_PTE_SWPTYP_LOBIT);
+    SETVAL(*pte, (pte_t)swpoff, PAGING_PTE_SWPOFF_MASK, PAGING_PTE_SWPOFF_LOBIT);
+  }
+  else if (pre != 0) { // Non swap ~ page online
+    if (fpn > PAGING_PTE_FPN_MASK)
+      return -1;  // Frame number does not fit
 
-      SETVAL(*pte, swptyp, PAGING_PTE_SWPTYP_MASK, PAGING_PTE_SWPTYP_LOBIT);
-      SETVAL(*pte, swpoff, PAGING_PTE_SWPOFF_MASK, PAGING_PTE_SWPOFF_LOBIT);
-    }
+    SETBIT(*pte, PAGING_PTE_PRESENT_MASK);
+
+    SETVAL(*pte, (pte_t)fpn, PAGING_PTE_FPN_MASK, PAGING_PTE_FPN_LOBIT);
   }
 
+  if (drt != 0)
+    SETBIT(*pte, PAGING_PTE_DIRTY_MASK);
+
   return 0;
 }
 
@@ -85,8 +85,8 @@ int get_pd_from_pagenum(addr_t pgn, addr_t* pgd, addr_t* p4d, addr_t* pud, addr_
 }
 
 /* Helper function to traverse/create page table hierarchy */
-/* Returns a pointer to the PTE entry in the final PT table */
-addr_t *__get_pte_ptr(struct mm_struct *mm, int pgn, int alloc_mode) {
+/* Returns a pointer to the PMD entry covering the page */
+uint64_t *__get_pmd_ptr(struct mm_struct *mm, addr_t pgn, int alloc_mode) {
     addr_t pgd_idx, p4d_idx, pud_idx, pmd_idx, pt_idx;
     
     get_pd_from_pagenum(pgn, &pgd_idx, &p4d_idx, &pud_idx, &pmd_idx, &pt_idx);
@@ -124,17 +124,65 @@ addr_t *__get_pte_ptr(struct mm_struct *mm, int pgn, int alloc_mode) {
     }
 
     // Level 2: PMD
-    uint64_t *pt_base = (uint64_t *)pmd_base[pmd_idx];
+    return &pmd_base[pmd_idx];
+}
+
+/*
+ * __split_huge_pmd - break a huge PMD mapping down to a PT of 4KB pages
+ * @mm     : owner mm
+ * @pgn    : any page number inside the huge mapping
+ * @pmd_ent: the huge PMD entry
+ */
+int __split_huge_pmd(struct mm_struct *mm, addr_t pgn, uint64_t *pmd_ent)
+{
+  uint64_t *pt_base;
+  addr_t basepgn = pgn & ~(addr_t)(PAGING64_HUGE_PGNUM - 1);
+  pte_t pte = *pmd_ent & ~PAGING64_PMD_HUGE_MASK;
+  addr_t fpn = PAGING_FPN(pte);
+  int i;
+
+  pt_base = malloc(PAGING64_PT_SZ * sizeof(uint64_t));
+  for (i = 0; i < PAGING64_PT_SZ; i++) {
+    pte_t subpte = pte;
+    SETVAL(subpte, (fpn + i), PAGING_PTE_FPN_MASK, PAGING_PTE_FPN_LOBIT);
+    pt_base[i] = subpte;
+
+    /* The head page is already on the reclaim ring */
+    if (i > 0)
+      pgrepl_add(mm, basepgn + i);
+  }
+
+  *pmd_ent = (uint64_t)pt_base;
+  return 0;
+}
+
+/* Returns a pointer to the PTE entry in the final PT table */
+pte_t *__get_pte_ptr(struct mm_struct *mm, addr_t pgn, int alloc_mode) {
+    addr_t pgd_idx, p4d_idx, pud_idx, pmd_idx, pt_idx;
+    uint64_t *pmd_ent;
+
+    get_pd_from_pagenum(pgn, &pgd_idx, &p4d_idx, &pud_idx, &pmd_idx, &pt_idx);
+
+    pmd_ent = __get_pmd_ptr(mm, pgn, alloc_mode);
+    if (pmd_ent == NULL) return NULL;
+
+    /* A single PTE inside a huge mapping only exists once it is split */
+    if (PAGING64_PMD_HUGE(*pmd_ent)) {
+        if (!alloc_mode) return NULL;
+        __split_huge_pmd(mm, pgn, pmd_ent);
+    }
+
+    uint64_t *pt_base = (uint64_t *)*pmd_ent;
     if (pt_base == NULL) {
         if (!alloc_mode) return NULL;
         pt_base = malloc(PAGING64_PT_SZ * sizeof(uint64_t));
         /* FIX: Phải memset về 0 ngay lập tức */
         memset(pt_base, 0, PAGING64_PT_SZ * sizeof(uint64_t));
-        pmd_base[pmd_idx] = (uint64_t)pt_base;
+        *pmd_ent = (uint64_t)pt_base;
     }
 
     // Level 1: PT
-    return (addr_t *)&pt_base[pt_idx];
+    return (pte_t *)&pt_base[pt_idx];
 }
 
 
@@ -144,7 +192,7 @@ addr_t *__get_pte_ptr(struct mm_struct *mm, int pgn, int alloc_mode) {
 int pte_set_swap(struct pcb_t *caller, addr_t pgn, int swptyp, addr_t swpoff)
 {
   struct mm_struct *mm = caller->mm;
-  addr_t *pte;
+  pte_t *pte;
 
   if (mm == NULL) return -1;
 
@@ -152,14 +200,8 @@ int pte_set_swap(struct pcb_t *caller, addr_t pgn, int swptyp, addr_t swpoff)
   pte = __get_pte_ptr(mm, pgn, 1); 
   if (pte == NULL) return -1; 
 
-  /* Set bit masks */
-  SETBIT(*pte, PAGING_PTE_PRESENT_MASK);
-  SETBIT(*pte, PAGING_PTE_SWAPPED_MASK);
-
-  SETVAL(*pte, swptyp, PAGING_PTE_SWPTYP_MASK, PAGING_PTE_SWPTYP_LOBIT);
-  SETVAL(*pte, swpoff, PAGING_PTE_SWPOFF_MASK, PAGING_PTE_SWPOFF_LOBIT);
-
-  return 0;
+  /* A swapped page is no longer online */
+  return init_pte(pte, 0, 0, 0, 1, swptyp, swpoff);
 }
 
 /*
@@ -168,7 +210,7 @@ int pte_set_swap(struct pcb_t *caller, addr_t pgn, int swptyp, addr_t swpoff)
 int pte_set_fpn(struct pcb_t *caller, addr_t pgn, addr_t fpn)
 {
   struct mm_struct *mm = caller->mm;
-  addr_t *pte;
+  pte_t *pte;
 
   if (mm == NULL) return -1;
 
@@ -176,36 +218,102 @@ int pte_set_fpn(struct pcb_t *caller, addr_t pgn, addr_t fpn)
   pte = __get_pte_ptr(mm, pgn, 1);
   if (pte == NULL) return -1;
 
-  SETBIT(*pte, PAGING_PTE_PRESENT_MASK);
-  CLRBIT(*pte, PAGING_PTE_SWAPPED_MASK);
-
-  SETVAL(*pte, fpn, PAGING_PTE_FPN_MASK, PAGING_PTE_FPN_LOBIT);
-
-  return 0;
+  return init_pte(pte, 1, fpn, 0, 0, 0, 0);
 }
 
 
 /* Get PTE page table entry */
-uint32_t pte_get_entry(struct pcb_t *caller, addr_t pgn)
+pte_t pte_get_entry(struct pcb_t *caller, addr_t pgn)
 {
   struct mm_struct *mm = caller->mm;
-  addr_t *pte_ptr;
+  uint64_t *pmd_ent;
+  pte_t *pte_ptr;
   
   if (mm == NULL) return 0;
 
+  /* Pages inside a huge mapping share the PMD entry */
+  pmd_ent = __get_pmd_ptr(mm, pgn, 0);
+  if (pmd_ent != NULL && PAGING64_PMD_HUGE(*pmd_ent)) {
+    pte_t pte = *pmd_ent & ~PAGING64_PMD_HUGE_MASK;
+    SETVAL(pte, (PAGING_FPN(pte) + (pgn % PAGING64_HUGE_PGNUM)),
+           PAGING_PTE_FPN_MASK, PAGING_PTE_FPN_LOBIT);
+    return pte;
+  }
+
   /* Perform multi-level page mapping (no alloc) */
   pte_ptr = __get_pte_ptr(mm, pgn, 0); 
   
   if (pte_ptr == NULL) return 0; 
 
-  return (uint32_t)(*pte_ptr); 
+  return *pte_ptr; 
+}
+
+/*
+ * __get_leaf_ptr - entry mapping a page, the PMD one for huge mappings
+ * Never allocates nor splits.
+ */
+uint64_t *__get_leaf_ptr(struct mm_struct *mm, addr_t pgn)
+{
+  uint64_t *pmd_ent = __get_pmd_ptr(mm, pgn, 0);
+
+  if (pmd_ent == NULL)
+    return NULL;
+  if (PAGING64_PMD_HUGE(*pmd_ent))
+    return pmd_ent;
+
+  return (uint64_t *)__get_pte_ptr(mm, pgn, 0);
+}
+
+/*
+ * pte_mkyoung - mark a page referenced
+ * A huge mapping has a single bit for the whole block.
+ */
+int pte_mkyoung(struct mm_struct *mm, addr_t pgn)
+{
+  uint64_t *ent = __get_leaf_ptr(mm, pgn);
+
+  if (ent == NULL)
+    return -1;
+
+  SETBIT(*ent, PAGING_PTE_ACCESSED_MASK);
+  return 0;
+}
+
+/*
+ * pte_test_and_clear_young - clear the referenced bit of a page
+ * Returns whether it was set.
+ */
+int pte_test_and_clear_young(struct mm_struct *mm, addr_t pgn)
+{
+  uint64_t *ent = __get_leaf_ptr(mm, pgn);
+
+  if (ent == NULL || !PAGING_PAGE_ACCESSED(*ent))
+    return 0;
+
+  CLRBIT(*ent, PAGING_PTE_ACCESSED_MASK);
+  return 1;
+}
+
+/*
+ * pte_mkdirty - mark a page written
+ * Returns whether it was clean before.
+ */
+int pte_mkdirty(struct mm_struct *mm, addr_t pgn)
+{
+  uint64_t *ent = __get_leaf_ptr(mm, pgn);
+
+  if (ent == NULL || (*ent & PAGING_PTE_DIRTY_MASK))
+    return 0;
+
+  SETBIT(*ent, PAGING_PTE_DIRTY_MASK);
+  return 1;
 }
 
 /* Set PTE page table entry */
-int pte_set_entry(struct pcb_t *caller, addr_t pgn, uint32_t pte_val)
+int pte_set_entry(struct pcb_t *caller, addr_t pgn, pte_t pte_val)
 {
   struct mm_struct *mm = caller->mm;
-  addr_t *pte_ptr;
+  pte_t *pte_ptr;
 
   if (mm == NULL) return -1;
 
@@ -226,7 +334,7 @@ int vmap_pgd_memset(struct pcb_t *caller,
                     int pgnum) 
 {
   int i;
-  addr_t pgn_start = PAGING_PGN(addr);
+  addr_t pgn_start = PAGING64_ADDR_PGN(addr);
   struct mm_struct *mm = caller->mm;
 
   if (mm == NULL) return -1;
@@ -244,31 +352,24 @@ int vmap_pgd_memset(struct pcb_t *caller,
 addr_t vmap_page_range(struct pcb_t *caller, 
                      addr_t addr, 
                      int pgnum, 
-                     struct framephy_struct *frames, 
+                     addr_t *frames, 
                      struct vm_rg_struct *ret_rg) 
 {
-  struct framephy_struct *fpit = frames;
   int pgit = 0;
   addr_t pgn;
-  addr_t fpn;
 
   /* Update the rg_end and rg_start of ret_rg */
   ret_rg->rg_start = addr;
   /* FIX: Dùng PAGING64_PAGESZ */
   ret_rg->rg_end = addr + pgnum * PAGING64_PAGESZ;
 
-  pgn = PAGING_PGN(addr);
+  pgn = PAGING64_ADDR_PGN(addr);
   
   for (pgit = 0; pgit < pgnum; pgit++) {
-      if (fpit == NULL) break; 
-
-      fpn = fpit->fpn;
-      pte_set_fpn(caller, pgn + pgit, fpn);
+      pte_set_fpn(caller, pgn + pgit, frames[pgit]);
 
       if (caller->mm)
-          enlist_pgn_node(&caller->mm->fifo_pgn, pgn + pgit);
-
-      fpit = fpit->fp_next;
+          pgrepl_add(caller->mm, pgn + pgit);
   }
 
   return 0;
@@ -276,41 +377,52 @@ addr_t vmap_page_range(struct pcb_t *caller,
 
 /*
  * alloc_pages_range - allocate req_pgnum of frame in ram
+ * @frames: array receiving the frames
  */
-addr_t alloc_pages_range(struct pcb_t *caller, int req_pgnum, struct framephy_struct **frm_lst)
+addr_t alloc_pages_range(struct pcb_t *caller, int req_pgnum, addr_t *frames)
 {
-  int pgit;
-  addr_t fpn;
-  struct framephy_struct *newfp_str;
-  
-  *frm_lst = NULL;
-  struct framephy_struct *tail = NULL;
-
-  for (pgit = 0; pgit < req_pgnum; pgit++)
+  // NOTE: mram is shared via kernel, so caller->krnl->mram is correct here
+  if (MEMPHY_get_freefp_n(caller->krnl->mram, req_pgnum, frames) != 0)
   {
-    newfp_str = malloc(sizeof(struct framephy_struct));
-    
-    // NOTE: mram is shared via kernel, so caller->krnl->mram is correct here
-    if (MEMPHY_get_freefp(caller->krnl->mram, &fpn) == 0)
-    {
-      newfp_str->fpn = fpn;
-      newfp_str->owner = caller->mm; // Fix: Owner is process MM
-      newfp_str->fp_next = NULL;
-
-      if (*frm_lst == NULL) {
-          *frm_lst = newfp_str;
-          tail = newfp_str;
-      } else {
-          tail->fp_next = newfp_str;
-          tail = newfp_str;
-      }
-    }
-    else
-    { 
-      return -3000; 
-    }
+    /* Nothing was taken, the daemon makes room for a retry */
+    kswapd_wakeup(caller->krnl->mram);
+    return -3000; 
   }
 
+  kswapd_wakeup(caller->krnl->mram);
+  return 0;
+}
+
+/*
+ * vmap_huge_page - map a 2MB aligned block with a single PMD entry
+ * @caller: caller
+ * @addr  : start address, aligned to PAGING64_HUGE_PAGESZ
+ */
+int vmap_huge_page(struct pcb_t *caller, addr_t addr)
+{
+  addr_t pgn = PAGING64_ADDR_PGN(addr);
+  uint64_t *pmd_ent;
+  pte_t pte;
+  addr_t fpn;
+
+  if (caller->mm == NULL || !PAGING64_HUGE_ALIGNED(addr))
+    return -1;
+
+  /* The block must not be partially mapped already */
+  pmd_ent = __get_pmd_ptr(caller->mm, pgn, 1);
+  if (pmd_ent == NULL || *pmd_ent != 0)
+    return -1;
+
+  if (MEMPHY_get_freefp_range(caller->krnl->mram, PAGING64_HUGE_PGNUM, &fpn) != 0)
+    return -1;
+
+  init_pte(&pte, 1, fpn, 0, 0, 0, 0);
+  *pmd_ent = PAGING64_PMD_HUGE_MASK | pte;
+
+  /* One reclaim node stands for the whole block until it gets split */
+  pgrepl_add(caller->mm, pgn);
+
+  kswapd_wakeup(caller->krnl->mram);
   return 0;
 }
 
@@ -319,37 +431,57 @@ addr_t alloc_pages_range(struct pcb_t *caller, int req_pgnum, struct framephy_st
  */
 addr_t vm_map_ram(struct pcb_t *caller, addr_t astart, addr_t aend, addr_t mapstart, int incpgnum, struct vm_rg_struct *ret_rg)
 {
-  struct framephy_struct *frm_lst = NULL;
+#ifdef MM_DEMAND_PAGING
+  /* Only the virtual range is reserved, pg_getpage binds frames on touch */
+  ret_rg->rg_start = mapstart;
+  ret_rg->rg_end = mapstart + incpgnum * PAGING64_PAGESZ;
+
+  return 0;
+#else
+  addr_t frames[PAGING64_HUGE_PGNUM];
+  struct vm_rg_struct rg;
   addr_t ret_alloc = 0;
+  addr_t mapaddr = mapstart;
+  int pgnum;
+
+  while (incpgnum > 0)
+  {
+    /* Aligned blocks of a whole PT are backed by a huge page if RAM allows */
+    if (incpgnum >= PAGING64_HUGE_PGNUM && PAGING64_HUGE_ALIGNED(mapaddr) &&
+        vmap_huge_page(caller, mapaddr) == 0)
+    {
+      mapaddr += PAGING64_HUGE_PAGESZ;
+      incpgnum -= PAGING64_HUGE_PGNUM;
+      continue;
+    }
+
+    /* Otherwise map 4KB pages up to the next huge boundary */
+    pgnum = PAGING64_HUGE_PGNUM - PAGING64_ADDR_PGN(mapaddr) % PAGING64_HUGE_PGNUM;
+    if (pgnum > incpgnum)
+      pgnum = incpgnum;
+
+    ret_alloc = alloc_pages_range(caller, pgnum, frames);
 
-  ret_alloc = alloc_pages_range(caller, incpgnum, &frm_lst);
+    if (ret_alloc == -3000) return -1; 
 
-  if (ret_alloc == -3000) return -1; 
+    vmap_page_range(caller, mapaddr, pgnum, frames, &rg);
 
-  vmap_page_range(caller, mapstart, incpgnum, frm_lst, ret_rg);
+    mapaddr += pgnum * PAGING64_PAGESZ;
+    incpgnum -= pgnum;
+  }
+
+  ret_rg->rg_start = mapstart;
+  ret_rg->rg_end = mapaddr;
 
   return 0;
+#endif
 }
 
 /* Swap copy content page from source frame to destination frame */
 int __swap_cp_page(struct memphy_struct *mpsrc, addr_t srcfpn,
                    struct memphy_struct *mpdst, addr_t dstfpn)
 {
- int cellidx;
-  addr_t addrsrc, addrdst;
-  /* FIX: Dùng PAGING64_PAGESZ */
-  for (cellidx = 0; cellidx < PAGING64_PAGESZ; cellidx++)
-  {
-    /* FIX: Dùng PAGING64_PAGESZ */
-    addrsrc = srcfpn * PAGING64_PAGESZ + cellidx;
-    addrdst = dstfpn * PAGING64_PAGESZ + cellidx;
-
-    BYTE data;
-    MEMPHY_read(mpsrc, addrsrc, &data);
-    MEMPHY_write(mpdst, addrdst, data);
-  }
-
-  return 0;
+  return MEMPHY_copy_page(mpsrc, srcfpn, mpdst, dstfpn);
 }
 
 /*
@@ -357,8 +489,6 @@ int __swap_cp_page(struct memphy_struct *mpsrc, addr_t srcfpn,
  */
 int init_mm(struct mm_struct *mm, struct pcb_t *caller)
 {
-  struct vm_area_struct *vma0 = malloc(sizeof(struct vm_area_struct));
-
   /* Init page table directory - 64 bit PGD */
   mm->pgd = malloc(PAGING64_PGD_SZ * sizeof(uint64_t));
   /* FIX: Phải memset về 0 */
@@ -369,31 +499,181 @@ int init_mm(struct mm_struct *mm, struct pcb_t *caller)
   mm->pmd = NULL;
   mm->pt  = NULL;
 
-  /* By default the owner comes with at least one vma */
-  vma0->vm_id = 0;
-  vma0->vm_start = 0;
-  vma0->vm_end = vma0->vm_start;
-  vma0->sbrk = vma0->vm_start;
-  struct vm_rg_struct *first_rg = init_vm_rg(vma0->vm_start, vma0->vm_end);
-  enlist_vm_rg_node(&vma0->vm_freerg_list, first_rg);
+  pgrepl_mm_init(mm);
+  symrg_init(mm);
 
-  /* update VMA0 next */
-  vma0->vm_next = NULL;
+  pthread_mutex_init(&mm->mm_lock, NULL);
 
-  /* Point vma owner backward */
-  vma0->vm_mm = mm; 
+  /* By default the owner comes with a heap and a stack */
+  if (vm_area_init(mm) != 0)
+    return -1;
 
-  /* update mmap */
-  mm->mmap = vma0;
-  
   /* Link the process PCB to this specific MM struct */
   if (caller != NULL) {
       caller->mm = mm;
+      kswapd_register(caller);
   }
 
   return 0;
 }
 
+/*
+ * __dup_pte - share the page behind a PTE with a child
+ * Online frames become read-only in both spaces and gain a reference,
+ * swap frames only gain a reference.  Shared segment frames just gain
+ * a reference.
+ */
+pte_t __dup_pte(struct pcb_t *caller, uint64_t *ent, int npages)
+{
+  pte_t pte = *ent & ~PAGING64_PMD_HUGE_MASK;
+  addr_t fpn;
+  int i;
+
+  if (PAGING_PAGE_PRESENT(pte)) {
+    fpn = PAGING_FPN(pte);
+    if (fpn != caller->krnl->zero_fpn)
+      for (i = 0; i < npages; i++)
+        MEMPHY_ref_fp(caller->krnl->mram, fpn + i);
+
+    /* Shared segment pages stay writable in both spaces */
+    if (!PAGING_PAGE_SHM(pte))
+      SETBIT(*ent, PAGING_PTE_WRPROT_MASK);
+  }
+  else if (PAGING_PAGE_SWAPPED(pte))
+    swap_ref_slot(PAGING_SWPTYP(pte), PAGING_SWP(pte));
+
+  return *ent;
+}
+
+/*
+ * __dup_pgtbl - duplicate one page table level and everything below it
+ * @level: 5 for PGD down to 1 for PT
+ */
+uint64_t *__dup_pgtbl(struct pcb_t *caller, uint64_t *src, int level)
+{
+  uint64_t *dst = calloc(PAGING64_PGD_SZ, sizeof(uint64_t));
+  int i;
+
+  for (i = 0; i < PAGING64_PGD_SZ; i++) {
+    if (src[i] == 0)
+      continue;
+
+    if (level == 1)
+      dst[i] = __dup_pte(caller, &src[i], 1);
+    else if (level == 2 && PAGING64_PMD_HUGE(src[i]))
+      dst[i] = __dup_pte(caller, &src[i], PAGING64_HUGE_PGNUM);
+    else
+      dst[i] = (uint64_t)__dup_pgtbl(caller, (uint64_t *)src[i], level - 1);
+  }
+
+  return dst;
+}
+
+/*
+ * dup_mm - clone the address space of a process into its child
+ * Frames are shared copy-on-write, pg_getpage copies them on first write.
+ * @caller: parent process
+ * @child : child process, gets a fresh mm
+ */
+int dup_mm(struct pcb_t *caller, struct pcb_t *child)
+{
+  struct mm_struct *src = caller->mm;
+  struct mm_struct *mm;
+
+  if (src == NULL)
+    return -1;
+
+  /* The parent may not change under the copy */
+  pthread_mutex_lock(&src->mm_lock);
+
+  mm = malloc(sizeof(struct mm_struct));
+  memcpy(mm, src, sizeof(struct mm_struct));
+  pthread_mutex_init(&mm->mm_lock, NULL);
+
+  mm->pgd = __dup_pgtbl(caller, src->pgd, 5);
+
+  /* Same areas and free regions, owned by the new mm */
+  vm_area_dup(mm, src);
+
+  /* Same resident pages, in the same reclaim state */
+  pgrepl_mm_dup(mm, src);
+  symrg_dup(mm, src);
+
+  pthread_mutex_unlock(&src->mm_lock);
+
+  child->mm = mm;
+  kswapd_register(child);
+  return 0;
+}
+
+/*
+ * __free_pte - drop the frames behind a PTE on teardown
+ */
+void __free_pte(struct pcb_t *caller, uint64_t ent, int npages)
+{
+  pte_t pte = ent & ~PAGING64_PMD_HUGE_MASK;
+  addr_t fpn;
+  int i;
+
+  if (PAGING_PAGE_PRESENT(pte)) {
+    fpn = PAGING_FPN(pte);
+    if (fpn != caller->krnl->zero_fpn)
+      for (i = 0; i < npages; i++)
+        swap_free_frame(caller->krnl->mram, fpn + i);
+  }
+  else if (PAGING_PAGE_SWAPPED(pte))
+    swap_put_slot(PAGING_SWPTYP(pte), PAGING_SWP(pte));
+}
+
+/*
+ * __free_pgtbl - release one page table level and everything below it
+ * @level: 5 for PGD down to 1 for PT
+ */
+void __free_pgtbl(struct pcb_t *caller, uint64_t *tbl, int level)
+{
+  int i;
+
+  for (i = 0; i < PAGING64_PGD_SZ; i++) {
+    if (tbl[i] == 0)
+      continue;
+
+    if (level == 1)
+      __free_pte(caller, tbl[i], 1);
+    else if (level == 2 && PAGING64_PMD_HUGE(tbl[i]))
+      __free_pte(caller, tbl[i], PAGING64_HUGE_PGNUM);
+    else
+      __free_pgtbl(caller, (uint64_t *)tbl[i], level - 1);
+  }
+
+  free(tbl);
+}
+
+/*
+ * free_mm - tear down the address space of an exiting process
+ * Frames and swap frames go back to their devices (shared ones only lose
+ * a reference), tables and bookkeeping go back to the heap.
+ */
+int free_mm(struct pcb_t *caller)
+{
+  struct mm_struct *mm = caller->mm;
+
+  if (mm == NULL)
+    return -1;
+
+  if (mm->pgd != NULL)
+    __free_pgtbl(caller, mm->pgd, 5);
+
+  pgrepl_mm_release(mm);
+  symrg_release(mm);
+
+  vm_area_release(mm);
+
+  pthread_mutex_destroy(&mm->mm_lock);
+  free(mm);
+  caller->mm = NULL;
+  return 0;
+}
+
 struct vm_rg_struct *init_vm_rg(addr_t rg_start, addr_t rg_end)
 {
   struct vm_rg_struct *rgnode = malloc(sizeof(struct vm_rg_struct));
@@ -401,6 +681,9 @@ struct vm_rg_struct *init_vm_rg(addr_t rg_start, addr_t rg_end)
   rgnode->rg_start = rg_start;
   rgnode->rg_end = rg_end;
   rgnode->rg_next = NULL;
+  rgnode->rg_prev = NULL;
+  rgnode->rg_snext = NULL;
+  rgnode->rg_enext = NULL;
 
   return rgnode;
 }
@@ -514,7 +797,12 @@ int print_pgtbl(struct pcb_t *caller, addr_t start, addr_t end)
 
                           /* Duyệt qua PMD (Level 2) */
                           for (l = 0; l < PAGING64_PMD_SZ; l++) {
-                              if (pmd[l] != 0) {
+                              if (PAGING64_PMD_HUGE(pmd[l])) {
+                                  /* Huge mapping: PMD holds the entry, not a PT */
+                                  printf(" PDG=%016lx P4g=%016lx PUD=%016lx PMD=%016lx HUGE FPN=%ld\n",
+                                         mm->pgd[i], p4d[j], pud[k], pmd[l],
+                                         (addr_t)PAGING_FPN(pmd[l]));
+                              } else if (pmd[l] != 0) {
                                   /* In ra địa chỉ các bảng theo format đề bài:
                                    * mm->pgd[i] : Địa chỉ bảng P4D
                                    * p4d[j]     : Địa chỉ bảng PUD
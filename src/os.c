@@ -4,11 +4,15 @@
 #include "sched.h"
 #include "loader.h"
 #include "mm.h"
+#include "mm64.h"
+#include "libmem.h"
 
 #include <pthread.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <getopt.h>
+#include <inttypes.h>
 
 static int time_slot;
 static int num_cpus;
@@ -16,8 +20,8 @@ static int done = 0;
 static struct krnl_t os;
 
 #ifdef MM_PAGING
-static int memramsz;
-static int memswpsz[PAGING_MAX_MMSWP];
+static uint64_t memramsz;
+static uint64_t memswpsz[PAGING_MAX_MMSWP];
 
 struct mmpaging_ld_args {
 	/* A dispatched argument struct to compact many-fields passing to loader */
@@ -36,6 +40,8 @@ struct mmpaging_ld_args {
 
 	int active_mswp_id;
 
+	addr_t zero_fpn;
+
 	struct timer_id_t  *timer_id;
 };
 #endif
@@ -80,14 +86,16 @@ static void * cpu_routine(void * args) {
 			/* No process is running, the we load new process from
 		 	* ready queue */
 			proc = get_proc();
-			if (proc == NULL) {
-                           next_slot(timer_id);
-                           continue; /* First load failed. skip dummy load */
-                        }
 		}else if (proc->pc == proc->code->size) {
 			/* The porcess has finish it job */
 			printf("\tCPU %d: Processed %2d has finished\n",
 				id ,proc->pid);
+#ifdef MM_PAGING
+			/* Return frames, swap and tables to the system */
+			free_pcb_memph(proc);
+#endif
+			free(proc->code->text);
+			free(proc->code);
 			free(proc);
 			proc = get_proc();
 			time_left = 0;
@@ -129,6 +137,7 @@ static void * ld_routine(void * args) {
 	struct memphy_struct* mram = ((struct mmpaging_ld_args *)args)->mram;
 	struct memphy_struct** mswp = ((struct mmpaging_ld_args *)args)->mswp;
 	struct memphy_struct* active_mswp = ((struct mmpaging_ld_args *)args)->active_mswp;
+	addr_t zero_fpn = ((struct mmpaging_ld_args *)args)->zero_fpn;
 	struct timer_id_t * timer_id = ((struct mmpaging_ld_args *)args)->timer_id;
 #else
 	struct timer_id_t * timer_id = (struct timer_id_t*)args;
@@ -153,6 +162,7 @@ static void * ld_routine(void * args) {
 		krnl->mram = mram;
 		krnl->mswp = mswp;
 		krnl->active_mswp = active_mswp;
+		krnl->zero_fpn = zero_fpn;
 #endif
 		printf("\tLoaded a process at %s, PID: %d PRIO: %ld\n",
 			ld_processes.path[i], proc->pid, ld_processes.prio[i]);
@@ -202,10 +212,17 @@ static void read_config(const char * path) {
 	 * Format: (size=0 result non-used memswap, must have RAM and at least 1 SWAP)
 	 *        MEM_RAM_SZ MEM_SWP0_SZ MEM_SWP1_SZ MEM_SWP2_SZ MEM_SWP3_SZ
 	*/
-	fscanf(file, "%d\n", &memramsz);
+	fscanf(file, "%" SCNu64 "\n", &memramsz);
 	for(sit = 0; sit < PAGING_MAX_MMSWP; sit++)
-		fscanf(file, "%d", &(memswpsz[sit])); 
+		fscanf(file, "%" SCNu64, &(memswpsz[sit])); 
        fscanf(file, "\n"); /* Final character */
+
+	/* RAM is handed out in whole frames */
+	if (memramsz < PAGING64_PAGESZ) {
+		printf("RAM of %" PRIu64 " bytes is smaller than a %d byte page\n",
+		       memramsz, PAGING64_PAGESZ);
+		exit(1);
+	}
 #endif
 #endif
 
@@ -228,17 +245,66 @@ static void read_config(const char * path) {
 	}
 }
 
+static void usage(void) {
+	printf("Usage: os [-p fifo|clock|lru|lfu|arc] [-s prio|stripe] "
+	       "[-f backing dir] [-q fifo|scan|clook] [-c seek,xfer] [-k] "
+	       "[path to configure file]\n");
+}
+
 int main(int argc, char * argv[]) {
+	/* Page replacement policy and swap device use, defaults if not given */
+	const char * policy = NULL;
+	const char * swapmode = NULL;
+	/* Directory of the files backing RAM and swap, in memory if not given */
+	const char * backdir = NULL;
+	/* Request order of sequential swap devices, random access if not given,
+	 * and their seek and transfer costs in slots per frame */
+	const char * iosched = NULL;
+	unsigned long seekcost = MEMPHY_SEEK_COST;
+	unsigned long xfercost = MEMPHY_XFER_COST;
+	/* Background reclaim races the CPUs, runs only reproduce without it */
+	int kswapd = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "p:s:f:q:c:k")) != -1) {
+		switch (opt) {
+		case 'p':
+			policy = optarg;
+			break;
+		case 's':
+			swapmode = optarg;
+			break;
+		case 'f':
+			backdir = optarg;
+			break;
+		case 'q':
+			iosched = optarg;
+			break;
+		case 'c':
+			if (sscanf(optarg, "%lu,%lu", &seekcost, &xfercost) != 2) {
+				usage();
+				return 1;
+			}
+			break;
+		case 'k':
+			kswapd = 1;
+			break;
+		default:
+			usage();
+			return 1;
+		}
+	}
+
 	/* Read config */
 	// argc là số lượng tham số truyền vào 
-	if (argc != 2) {
-		printf("Usage: os [path to configure file]\n");
+	if (optind != argc - 1) {
+		usage();
 		return 1;
 	}
 	char path[100];
 	path[0] = '\0';
 	strcat(path, "input/");
-	strcat(path, argv[1]);
+	strcat(path, argv[optind]);
 	read_config(path);
 
 	// cpu thread, tao ra thread de chay da luong
@@ -259,6 +325,7 @@ int main(int argc, char * argv[]) {
 #ifdef MM_PAGING
 	/* Init all MEMPHY include 1 MEMRAM and n of MEMSWP */
 	int rdmflag = 1; /* By default memphy is RANDOM ACCESS MEMORY */
+	int swprdmflag = (iosched == NULL); /* Swap is sequential with a queue */
 
 	struct memphy_struct mram;
 	// mswp dong vai tro la 1 o cung 
@@ -268,12 +335,58 @@ int main(int argc, char * argv[]) {
 
 	/* Create MEM RAM */
 	// khoi tao physical memory
-	init_memphy(&mram, memramsz, rdmflag);
-
-        /* Create all MEM SWAP */ 
 	int sit;
-	for(sit = 0; sit < PAGING_MAX_MMSWP; sit++)
-	       init_memphy(&mswp[sit], memswpsz[sit], rdmflag);
+	if (backdir != NULL) {
+		char devpath[256];
+
+		/* Devices live in <dir>/ram and <dir>/swap<N> */
+		snprintf(devpath, sizeof(devpath), "%s/ram", backdir);
+		if (init_memphy_file(&mram, memramsz, rdmflag, devpath) != 0) {
+			printf("Cannot map %s\n", devpath);
+			return 1;
+		}
+
+		for (sit = 0; sit < PAGING_MAX_MMSWP; sit++) {
+			snprintf(devpath, sizeof(devpath), "%s/swap%d", backdir, sit);
+			if (init_memphy_file(&mswp[sit], memswpsz[sit], swprdmflag,
+			                     devpath) != 0) {
+				printf("Cannot map %s\n", devpath);
+				return 1;
+			}
+		}
+	} else {
+		if (init_memphy(&mram, memramsz, rdmflag) != 0) {
+			printf("Cannot reserve %" PRIu64 " bytes of RAM\n", memramsz);
+			return 1;
+		}
+
+	        /* Create all MEM SWAP */ 
+		for(sit = 0; sit < PAGING_MAX_MMSWP; sit++)
+		       if (init_memphy(&mswp[sit], memswpsz[sit], swprdmflag) != 0) {
+				printf("Cannot reserve %" PRIu64 " bytes of swap %d\n",
+				       memswpsz[sit], sit);
+				return 1;
+		       }
+	}
+
+	for (sit = 0; sit < PAGING_MAX_MMSWP && iosched != NULL; sit++)
+		if (MEMPHY_set_iosched(&mswp[sit], iosched, seekcost, xfercost) != 0) {
+			printf("Unknown swap I/O scheduler %s\n", iosched);
+			usage();
+			return 1;
+		}
+
+	if (swap_init(mswp, PAGING_MAX_MMSWP, swapmode) != 0) {
+		printf("Unknown swap mode %s\n", swapmode);
+		usage();
+		return 1;
+	}
+
+	if (pgrepl_init(policy, &mram) != 0) {
+		printf("Unknown page replacement policy %s\n", policy);
+		usage();
+		return 1;
+	}
 
 	/* In Paging mode, it needs passing the system mem to each PCB through loader*/
 	struct mmpaging_ld_args *mm_ld_args = malloc(sizeof(struct mmpaging_ld_args));
@@ -283,6 +396,22 @@ int main(int argc, char * argv[]) {
 	mm_ld_args->mswp = (struct memphy_struct**) &mswp;
 	mm_ld_args->active_mswp = (struct memphy_struct *) &mswp[0];
     mm_ld_args->active_mswp_id = 0;
+
+	/* Reserve the shared zero frame backing untouched pages on read,
+	 * unless it would leave no frame to hold pages */
+	if (mram.free_fp_cnt < 2 ||
+	    MEMPHY_get_freefp(&mram, &mm_ld_args->zero_fpn) != 0)
+		mm_ld_args->zero_fpn = PAGING_FPN_INVALID;
+	swap_cache_init(&mram);
+
+#ifdef MM_ZSWAP
+	zswap_init(&mram);
+#endif
+#ifdef MM_KSWAPD
+	/* Keep a few RAM frames free in the background */
+	if (kswapd)
+		kswapd_start(&mram);
+#endif
 #endif
 
 	/* Init scheduler */
@@ -303,6 +432,17 @@ int main(int argc, char * argv[]) {
 		pthread_join(cpu[i], NULL);
 	}
 	pthread_join(ld, NULL);
+#ifdef MM_PAGING
+#ifdef MM_KSWAPD
+	kswapd_stop();
+#endif
+	pgrepl_report();
+#ifdef MM_ZSWAP
+	zswap_report();
+#endif
+	pgcache_report();
+	swap_report();
+#endif
 	/* Stop timer */
 	stop_timer();
 
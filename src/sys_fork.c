@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2026 pdnguyen of HCMC University of Technology VNU-HCM
+ */
+
+/* LamiaAtrium release
+ * Source Code License Grant: The authors hereby grant to Licensee
+ * personal permission to use and modify the Licensed Source Code
+ * for the sole purpose of studying while attending the course CO2018.
+ */
+
+#include "common.h"
+#include "syscall.h"
+#include "loader.h"
+#include "sched.h"
+#include "mm.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * __sys_fork - clone the calling process
+ * a1: register receiving the fork result.  Parent and child share
+ * every frame copy-on-write.  The parent's register gets the child
+ * pid, the child's gets 0, and the child pid also comes back in a1.
+ */
+int __sys_fork(struct krnl_t *krnl, uint32_t pid, struct sc_regs* regs)
+{
+   struct pcb_t *caller = get_proc_by_id(krnl, pid);
+   struct pcb_t *child;
+   uint32_t reg = regs->a1;
+
+   if (caller == NULL || reg >= sizeof(caller->regs) / sizeof(addr_t))
+      return -1;
+
+   child = clone_proc(caller);
+
+#ifdef MM_PAGING
+   if (dup_mm(caller, child) != 0)
+   {
+      free(child->code->text);
+      free(child->code);
+      free(child);
+      return -1;
+   }
+#endif
+
+   /* Both resume after the fork, only the return register differs */
+   caller->regs[reg] = child->pid;
+   child->regs[reg] = 0;
+
+   printf("\tForked process %2d from PID: %d PRIO: %d\n",
+          child->pid, caller->pid, child->prio);
+   printf("\tFork returned %d to PID: %d, %d to PID: %d\n",
+          (int)caller->regs[reg], caller->pid,
+          (int)child->regs[reg], child->pid);
+
+   regs->a1 = child->pid;
+   add_proc(child);
+
+   return 0;
+}
@@ -1,10 +1,11 @@
 /* src/sys_mem.c */
-#include "os-mm.h"
+#include "common.h"
 #include "syscall.h"
 #include "libmem.h"
 #include "queue.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <pthread.h>
 
 #ifdef MM64
 #include "mm64.h"
@@ -32,7 +33,7 @@ struct pcb_t *get_proc_by_id(struct krnl_t *krnl, uint32_t pid) {
     /* Lưu ý: Tùy implementation mà running_list là con trỏ hoặc struct. 
        Ta check cả 2 trường hợp an toàn */
 #ifdef MLQ_SCHED
-    proc = check_proc_in_queue(&krnl->running_list, pid);
+    proc = check_proc_in_queue(krnl->running_list, pid);
     if (proc) return proc;
     
     /* 2. Tìm trong MLQ Ready Queues */
@@ -53,6 +54,8 @@ int __sys_memmap(struct krnl_t *krnl, uint32_t pid, struct sc_regs* regs)
 {
    int memop = regs->a1;
    BYTE value;
+   addr_t addr = 0;
+   int ret;
    
    /* Tìm PCB thật sự */
    struct pcb_t *caller = get_proc_by_id(krnl, pid);
@@ -78,6 +81,26 @@ int __sys_memmap(struct krnl_t *krnl, uint32_t pid, struct sc_regs* regs)
    case SYSMEM_IO_WRITE:
            MEMPHY_write(krnl->mram, regs->a2, (BYTE)regs->a3);
            break;
+   case SYSMEM_MMAP_OP:
+           /* a2: length, a3: region handle bound to the new area */
+           pthread_mutex_lock(&caller->mm->mm_lock);
+           ret = vm_mmap_anon(caller, regs->a2, regs->a3, &addr);
+           pthread_mutex_unlock(&caller->mm->mm_lock);
+           if (ret < 0)
+              return -1;
+           printf("\tMapped %lu bytes at %lx PID: %d\n",
+                  (unsigned long)regs->a2, addr, caller->pid);
+           break;
+   case SYSMEM_STACK_OP:
+           /* a2: length, a3: region handle bound to the pushed bytes */
+           pthread_mutex_lock(&caller->mm->mm_lock);
+           ret = vm_stack_push(caller, regs->a2, regs->a3, &addr);
+           pthread_mutex_unlock(&caller->mm->mm_lock);
+           if (ret < 0)
+              return -1;
+           printf("\tPushed %lu stack bytes at %lx PID: %d\n",
+                  (unsigned long)regs->a2, addr, caller->pid);
+           break;
    default:
            break;
    }
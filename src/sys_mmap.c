@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2026 pdnguyen of HCMC University of Technology VNU-HCM
+ */
+
+/* LamiaAtrium release
+ * Source Code License Grant: The authors hereby grant to Licensee
+ * personal permission to use and modify the Licensed Source Code
+ * for the sole purpose of studying while attending the course CO2018.
+ */
+
+#include "common.h"
+#include "syscall.h"
+#include "mm.h"
+#include <stdio.h>
+#include <pthread.h>
+
+#define MMAP_PATH_MAX 256
+
+/*
+ * __sys_mmap - map a host file into the calling process
+ * a1: region handle holding the NUL terminated path, a2: region handle
+ * the file contents get bound to.  The start of the mapping comes back
+ * in a1.
+ */
+int __sys_mmap(struct krnl_t *krnl, uint32_t pid, struct sc_regs* regs)
+{
+   struct pcb_t *caller = get_proc_by_id(krnl, pid);
+   char path[MMAP_PATH_MAX];
+   addr_t addr;
+   BYTE c;
+   int i, ret;
+
+   if (caller == NULL || caller->mm == NULL)
+      return -1;
+
+   /* The path lives in user memory, it is read like any other data.
+    * A path without its NUL inside MMAP_PATH_MAX bytes is refused. */
+   for (i = 0; i < MMAP_PATH_MAX; i++)
+   {
+      if (__read(caller, 0, regs->a1, i, &c) != 0)
+         return -1;
+      path[i] = c;
+      if (c == 0)
+         break;
+   }
+   if (i == 0 || i == MMAP_PATH_MAX)
+      return -1;
+
+   pthread_mutex_lock(&caller->mm->mm_lock);
+   ret = filemap_mmap(caller, path, regs->a2, &addr);
+   pthread_mutex_unlock(&caller->mm->mm_lock);
+
+   if (ret != 0)
+      return -1;
+
+   printf("\tMapped file %s at %lx PID: %d\n", path, addr, caller->pid);
+
+   regs->a1 = addr;
+   return 0;
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2026 pdnguyen of HCMC University of Technology VNU-HCM
+ */
+
+/* LamiaAtrium release
+ * Source Code License Grant: The authors hereby grant to Licensee
+ * personal permission to use and modify the Licensed Source Code
+ * for the sole purpose of studying while attending the course CO2018.
+ */
+
+#include "common.h"
+#include "syscall.h"
+#include "mm.h"
+#include <stdio.h>
+#include <pthread.h>
+
+/*
+ * __sys_shmget - find or create a shared memory segment
+ * a1: key, a2: size in bytes.  The segment id, its key, comes back
+ * in a1.
+ */
+int __sys_shmget(struct krnl_t *krnl, uint32_t pid, struct sc_regs* regs)
+{
+   int shmid = shm_get(regs->a1, regs->a2);
+
+   if (shmid < 0)
+      return -1;
+
+   regs->a1 = shmid;
+   return 0;
+}
+
+/*
+ * __sys_shmat - map a segment into the calling process
+ * a1: segment id, a2: region handle the segment gets bound to.  The
+ * start of the mapping comes back in a1.
+ */
+int __sys_shmat(struct krnl_t *krnl, uint32_t pid, struct sc_regs* regs)
+{
+   struct pcb_t *caller = get_proc_by_id(krnl, pid);
+   addr_t addr;
+   int ret;
+
+   if (caller == NULL || caller->mm == NULL)
+      return -1;
+
+   pthread_mutex_lock(&caller->mm->mm_lock);
+   ret = shm_attach(caller, regs->a1, regs->a2, &addr);
+   pthread_mutex_unlock(&caller->mm->mm_lock);
+
+   if (ret != 0)
+      return -1;
+
+   printf("\tAttached segment %d at %lx PID: %d\n",
+          (int)regs->a1, addr, caller->pid);
+
+   regs->a1 = addr;
+   return 0;
+}
@@ -0,0 +1,69 @@
+/*
+ * Round trip of pages through the zswap pool
+ *
+ * Every page is stored from one RAM frame and loaded back into another,
+ * then compared byte for byte.  The contents are picked so the codec
+ * sees back offsets and bytes at or above 0x80.
+ */
+
+#include "mm.h"
+#include "mm64.h"
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_FRAMES 64
+#define TEST_PAGES 200
+
+/* __fill - page @i of the test set, compressible but never same-filled */
+static void __fill(BYTE *page, int i)
+{
+   unsigned int seed = 2166136261u ^ i;
+   int period = 3 + i * 37 % 1021;
+   int k;
+
+   memset(page, 0, PAGING64_PAGESZ);
+   for (k = 0; k < period; k++)
+   {
+      seed = seed * 1103515245u + 12345u;
+      page[k] = (BYTE)(seed >> 16);
+   }
+   /* Repeat the block, every match reaches back one period */
+   for (k = period; k < PAGING64_PAGESZ - i % 512; k++)
+      page[k] = page[k - period];
+}
+
+int main(void)
+{
+   struct memphy_struct ram;
+   BYTE page[PAGING64_PAGESZ];
+   BYTE back[PAGING64_PAGESZ];
+   int i, stored = 0, bad = 0;
+
+   if (init_memphy(&ram, (uint64_t)TEST_FRAMES * PAGING64_PAGESZ, 1) != 0)
+      return 1;
+   zswap_init(&ram);
+
+   for (i = 0; i < TEST_PAGES; i++)
+   {
+      __fill(page, i);
+      MEMPHY_write_page(&ram, 0, page);
+      if (zswap_store(&ram, 0, 0, i) != 0)
+         continue;
+      stored++;
+
+      memset(back, 0x5a, sizeof(back));
+      MEMPHY_write_page(&ram, 1, back);
+      if (zswap_load(&ram, 1, 0, i) != 0)
+      {
+         bad++;
+         continue;
+      }
+      MEMPHY_read_page(&ram, 1, back);
+      if (memcmp(page, back, PAGING64_PAGESZ) != 0)
+         bad++;
+      zswap_invalidate(0, i);
+   }
+
+   printf("zswap round trip: %d pages stored, %d corrupted\n", stored, bad);
+   return (stored == 0 || bad != 0) ? 1 : 0;
+}